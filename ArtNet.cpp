@@ -0,0 +1,77 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Art-Net packet encoding and decoding for streaming pixels over UDP.
+#include <cstring>
+
+#include "ArtNet.h"
+
+// Definitions of the constants, needed when they are bound to a reference
+// (for example by std::min) instead of being folded in as values.
+const int ArtNet::kPort;
+const int ArtNet::kPixelsPerUniverse;
+const int ArtNet::kUniverseSize;
+const int ArtNet::kMaxPacketSize;
+
+static const char kId[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+static const uint16_t kOpDmx = 0x5000;
+static const uint16_t kOpSync = 0x5200;
+static const uint8_t kProtocolVersion = 14;
+
+// Write the ID, little endian opcode and big endian protocol version that
+// start every packet.
+static void writeHeader(uint8_t* packet, uint16_t opcode) {
+  memcpy(packet, kId, sizeof(kId));
+  packet[8] = opcode & 0xFF;
+  packet[9] = opcode >> 8;
+  packet[10] = 0;
+  packet[11] = kProtocolVersion;
+}
+
+size_t ArtNet::buildDmx(uint8_t* packet, uint16_t universe, uint8_t sequence,
+                        const uint8_t* data, int length) {
+  // Channel data length must be even and between 2 and 512.
+  if (length > 512) {
+    length = 512;
+  }
+  int padded = (length < 2) ? 2 : (length + 1) & ~1;
+  writeHeader(packet, kOpDmx);
+  packet[12] = sequence;
+  packet[13] = 0;
+  packet[14] = universe & 0xFF;
+  packet[15] = (universe >> 8) & 0x7F;
+  packet[16] = padded >> 8;
+  packet[17] = padded & 0xFF;
+  memcpy(packet + 18, data, length);
+  memset(packet + 18 + length, 0, padded - length);
+  return 18 + padded;
+}
+
+size_t ArtNet::buildSync(uint8_t* packet) {
+  writeHeader(packet, kOpSync);
+  packet[12] = 0;
+  packet[13] = 0;
+  return 14;
+}
+
+ArtNet::PacketType ArtNet::parse(const uint8_t* packet, size_t size,
+                                 uint16_t* universe, uint8_t* sequence,
+                                 const uint8_t** data, int* length) {
+  if ((size < 12) || (memcmp(packet, kId, sizeof(kId)) != 0)) {
+    return kInvalid;
+  }
+  uint16_t opcode = packet[8] | (packet[9] << 8);
+  if (opcode == kOpSync) {
+    return kSync;
+  }
+  if ((opcode != kOpDmx) || (size < 18)) {
+    return kInvalid;
+  }
+  int declared = (packet[16] << 8) | packet[17];
+  if ((declared > 512) || (18 + (size_t)declared > size)) {
+    return kInvalid;
+  }
+  *sequence = packet[12];
+  *universe = packet[14] | ((packet[15] & 0x7F) << 8);
+  *data = packet + 18;
+  *length = declared;
+  return kDmx;
+}
@@ -0,0 +1,39 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Art-Net packet encoding and decoding for streaming pixels over UDP.
+#ifndef ARTNET_H
+#define ARTNET_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Just the two packets needed to stream frames: ArtDmx carries up to 512
+// channels for one universe (170 RGB pixels, 510 channels, are used) and
+// ArtSync tells receivers the frame is complete and should be shown.
+class ArtNet {
+public:
+  static const int kPort = 6454;
+  static const int kPixelsPerUniverse = 170;
+  static const int kUniverseSize = kPixelsPerUniverse*3;
+  static const int kMaxPacketSize = 18 + 512;
+
+  enum PacketType {
+    kInvalid,
+    kDmx,
+    kSync
+  };
+
+  // Fill packet (at least kMaxPacketSize bytes) with an ArtDmx packet of up
+  // to 512 channels of data and return its size.
+  static size_t buildDmx(uint8_t* packet, uint16_t universe, uint8_t sequence,
+                         const uint8_t* data, int length);
+  // Fill packet with an ArtSync packet and return its size.
+  static size_t buildSync(uint8_t* packet);
+
+  // Decode a received packet.  For ArtDmx packets the universe, sequence
+  // and the location and length of the channel data are returned as well.
+  static PacketType parse(const uint8_t* packet, size_t size,
+                          uint16_t* universe, uint8_t* sequence,
+                          const uint8_t** data, int* length);
+};
+
+#endif
@@ -0,0 +1,276 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that receives pixels streamed over the network with Art-Net.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ArtNet.h"
+#include "ArtNetFrameSource.h"
+
+using namespace std;
+
+ArtNetFrameSource::ArtNetFrameSource(int width, int height, int port,
+                                     int first_universe, int timeout_ms):
+  _socket(-1),
+  _first_universe(first_universe),
+  _universes(0),
+  _timeout_ms(timeout_ms),
+  _received_count(0),
+  _size(0),
+  _back(NULL),
+  _ready(NULL),
+  _ready_pending(false),
+  _sync_seen(false),
+  _frame_start(0),
+  _last_packet(0),
+  _packets(0),
+  _lost(0),
+  _frames(0),
+  _timeouts(0),
+  _reassembly("reassembly"),
+  _clock_offset(numeric_limits<int64_t>::max()),
+  _window_offset(0),
+  _window_count(0),
+  _back_frame(0),
+  _ready_frame(0),
+  _frame(0),
+  _back_present(0),
+  _ready_present(0),
+  _present_time(0),
+  _ready_offset(0),
+  _frame_offset(0),
+  _stopping(false)
+{
+  // All the buffers are allocated up front, nothing is allocated per packet.
+  // The back and ready buffers are only allocated once nothing else can
+  // throw, so the constructor does not leak them.
+  allocate(width, height, width*3);
+  _size = _pitch*_height;
+  _universes = (width*height + ArtNet::kPixelsPerUniverse - 1) / ArtNet::kPixelsPerUniverse;
+  // The last universe of the frame is at most 0x7FFF, the highest one.
+  if (_first_universe + _universes > 0x8000) {
+    throw invalid_argument("Art-Net frame does not fit in the universe range!");
+  }
+  _received.resize(_universes, false);
+  _sequences.resize(_universes, 0);
+
+  _socket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (_socket < 0) {
+    throw runtime_error("Unable to create Art-Net socket!");
+  }
+  // Make room for a few whole frames in the socket buffer so bursts of
+  // universes are not dropped while a frame is being swapped.
+  int buffer_size = max(256*1024, (int)_size*4);
+  setsockopt(_socket, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(_socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    close(_socket);
+    throw runtime_error("Unable to bind Art-Net socket, is the port already in use?");
+  }
+  _back = new uint8_t[_size]();
+  _ready = new uint8_t[_size]();
+  _thread = thread(&ArtNetFrameSource::run, this);
+}
+
+ArtNetFrameSource::~ArtNetFrameSource() {
+  _stopping = true;
+  _thread.join();
+  close(_socket);
+  delete[] _back;
+  delete[] _ready;
+}
+
+bool ArtNetFrameSource::capture() {
+  lock_guard<mutex> lock(_mutex);
+  if (!_ready_pending) {
+    return false;
+  }
+  swap(_data, _ready);
+  _ready_pending = false;
+  _frame = _ready_frame;
+  _present_time = _ready_present;
+  _frame_offset = _ready_offset;
+  return true;
+}
+
+bool ArtNetFrameSource::waitForFrame(int timeout_ms) {
+  unique_lock<mutex> lock(_mutex);
+  return _condition.wait_for(lock, chrono::milliseconds(timeout_ms),
+                             [this] { return _ready_pending; });
+}
+
+void ArtNetFrameSource::printStats(ostream& out) {
+  lock_guard<mutex> lock(_mutex);
+  int expected = _packets + _lost;
+  out << "Art-Net: " << _frames << " frames (" << _timeouts << " by timeout), "
+      << _packets << " packets, " << _lost << " lost ("
+      << ((expected > 0) ? 100.0*_lost/expected : 0.0) << "%)" << endl;
+  _reassembly.print(out);
+  _packets = _lost = _frames = _timeouts = 0;
+  _reassembly.clear();
+}
+
+void ArtNetFrameSource::run() {
+  uint8_t packet[ArtNet::kMaxPacketSize];
+  struct pollfd poll_fd;
+  poll_fd.fd = _socket;
+  poll_fd.events = POLLIN;
+  struct sockaddr_in sender;
+  while (!_stopping) {
+    // Wake up regularly to notice a timed out frame or a request to stop.
+    if (poll(&poll_fd, 1, 5) > 0) {
+      socklen_t sender_size = sizeof(sender);
+      ssize_t size = recvfrom(_socket, packet, sizeof(packet), 0,
+                              (struct sockaddr*)&sender, &sender_size);
+      if (size > 0) {
+        receive(packet, size, sender);
+      }
+    }
+    if ((_received_count > 0) &&
+        (LatencyStats::now() - _last_packet > (uint64_t)_timeout_ms*1000)) {
+      complete(true);
+    }
+  }
+}
+
+void ArtNetFrameSource::receive(const uint8_t* packet, size_t size,
+                                const struct sockaddr_in& sender) {
+  ShardProtocol::Packet shard;
+  if (ShardProtocol::parse(packet, size, &shard)) {
+    if (shard.type == ShardProtocol::kPresent) {
+      present(shard, sender);
+    }
+    return;
+  }
+  uint16_t universe;
+  uint8_t sequence;
+  const uint8_t* data;
+  int length;
+  ArtNet::PacketType type = ArtNet::parse(packet, size, &universe, &sequence,
+                                          &data, &length);
+  if (type == ArtNet::kSync) {
+    _sync_seen = true;
+    if (_received_count > 0) {
+      complete(false);
+    }
+    return;
+  }
+  int index = (int)universe - _first_universe;
+  if ((type != ArtNet::kDmx) || (index < 0) || (index >= _universes)) {
+    return;
+  }
+
+  // Without ArtSync a repeated universe means the sender has moved on to the
+  // next frame, so show what arrived of this one rather than mixing the two.
+  if (!_sync_seen && _received[index]) {
+    complete(false);
+  }
+  _last_packet = LatencyStats::now();
+  if (_received_count == 0) {
+    _frame_start = _last_packet;
+  }
+  {
+    lock_guard<mutex> lock(_mutex);
+    ++_packets;
+    // Sequence numbers run from 1 to 255, 0 means the sender does not use
+    // them.  Count the gap as lost packets, ignoring late (reordered) ones.
+    int last = _sequences[index];
+    if ((sequence != 0) && (last != 0)) {
+      int gap = (sequence - (last % 255 + 1) + 255) % 255;
+      if (gap < 128) {
+        _lost += gap;
+      }
+    }
+    _sequences[index] = sequence;
+  }
+
+  size_t offset = (size_t)index*ArtNet::kUniverseSize;
+  size_t count = min((size_t)min(length, ArtNet::kUniverseSize), _size - offset);
+  memcpy(_back + offset, data, count);
+  if (!_received[index]) {
+    _received[index] = true;
+    ++_received_count;
+  }
+  // Without ArtSync from the sender a frame is complete once all of its
+  // universes are in.
+  if (!_sync_seen && (_received_count == _universes)) {
+    complete(false);
+  }
+}
+
+void ArtNetFrameSource::present(const ShardProtocol::Packet& packet,
+                                const struct sockaddr_in& sender) {
+  int64_t offset = (int64_t)LatencyStats::now() - (int64_t)packet.sent_time;
+  if ((_window_count == 0) || (offset < _window_offset)) {
+    _window_offset = offset;
+  }
+  // Take a shorter delay at once, and the window's shortest every 64
+  // packets so drift between the clocks is followed.
+  if (offset < _clock_offset) {
+    _clock_offset = offset;
+  }
+  if (++_window_count == 64) {
+    _clock_offset = _window_offset;
+    _window_count = 0;
+  }
+  {
+    lock_guard<mutex> lock(_mutex);
+    _coordinator = sender;
+  }
+  _sync_seen = true;
+  _back_frame = packet.frame;
+  _back_present = packet.present_time + _clock_offset;
+  if (_received_count > 0) {
+    complete(false);
+  }
+}
+
+void ArtNetFrameSource::acknowledge(uint64_t shown_time) {
+  if (_present_time == 0) {
+    return;
+  }
+  ShardProtocol::Packet packet;
+  packet.type = ShardProtocol::kAck;
+  packet.frame = _frame;
+  packet.sent_time = LatencyStats::now() - _frame_offset;
+  packet.present_time = shown_time - _frame_offset;
+  uint8_t buffer[ShardProtocol::kPacketSize];
+  size_t size = ShardProtocol::build(buffer, packet);
+  lock_guard<mutex> lock(_mutex);
+  sendto(_socket, buffer, size, 0, (const struct sockaddr*)&_coordinator,
+         sizeof(_coordinator));
+}
+
+void ArtNetFrameSource::complete(bool timed_out) {
+  {
+    lock_guard<mutex> lock(_mutex);
+    swap(_back, _ready);
+    _ready_pending = true;
+    _ready_frame = _back_frame;
+    _ready_present = _back_present;
+    _ready_offset = _clock_offset;
+    ++_frames;
+    if (timed_out) {
+      ++_timeouts;
+    }
+    _reassembly.add(LatencyStats::now() - _frame_start);
+    // Start the next frame from this one, so universes that do not arrive
+    // keep their last values.
+    memcpy(_back, _ready, _size);
+  }
+  _condition.notify_all();
+  fill(_received.begin(), _received.end(), false);
+  _received_count = 0;
+  _back_present = 0;
+}
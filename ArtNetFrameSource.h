@@ -0,0 +1,107 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that receives pixels streamed over the network with Art-Net.
+#ifndef ARTNETFRAMESOURCE_H
+#define ARTNETFRAMESOURCE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <netinet/in.h>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "FrameSource.h"
+#include "LatencyStats.h"
+#include "ShardProtocol.h"
+
+// Pixels are packed row by row into consecutive universes starting at the
+// first universe, 170 pixels per universe.  A receiver thread assembles the
+// universes into a preallocated back buffer.  The frame is complete on an
+// ArtSync packet, when every universe has arrived or one arrives again (for
+// senders that never send ArtSync) or when no packet arrived for the timeout,
+// and capture() then swaps it in.
+//
+// As a node of a sharded display a ShardProtocol present packet from the
+// coordinator completes the frame instead of ArtSync, and gives it a frame
+// number and the time to show it on this node's clock.
+class ArtNetFrameSource: public FrameSource {
+public:
+  ArtNetFrameSource(int width, int height, int port, int first_universe,
+                    int timeout_ms);
+  virtual ~ArtNetFrameSource();
+
+  // Swap in the latest complete frame.  Returns false if no new frame
+  // arrived since the last call.
+  virtual bool capture();
+
+  // Wait up to timeout_ms for a complete frame.  Returns true if one is ready.
+  bool waitForFrame(int timeout_ms);
+
+  // Print and reset the packet loss and reassembly statistics.
+  void printStats(std::ostream& out);
+
+  // Frame number and present time (in LatencyStats::now() microseconds) from
+  // the coordinator for the captured frame.  The present time is 0 when the
+  // frame did not come from a coordinator.
+  uint32_t getFrame() const {
+    return _frame;
+  }
+  uint64_t getPresentTime() const {
+    return _present_time;
+  }
+  // Tell the coordinator when the captured frame was shown.
+  void acknowledge(uint64_t shown_time);
+
+private:
+  void run();
+  void receive(const uint8_t* packet, size_t size,
+               const struct sockaddr_in& sender);
+  void present(const ShardProtocol::Packet& packet,
+               const struct sockaddr_in& sender);
+  void complete(bool timed_out);
+
+  int _socket,
+      _first_universe,
+      _universes,
+      _timeout_ms,
+      _received_count;
+  size_t _size;
+  // Frame being assembled and the last complete frame not yet captured.
+  uint8_t* _back;
+  uint8_t* _ready;
+  std::vector<bool> _received;
+  std::vector<int> _sequences;
+  bool _ready_pending,
+       _sync_seen;
+  uint64_t _frame_start,
+           _last_packet;
+  // Statistics since they were last printed.
+  int _packets,
+      _lost,
+      _frames,
+      _timeouts;
+  LatencyStats _reassembly;
+  // Present packets.  The coordinator's clock is this node's clock minus the
+  // offset, estimated as the smallest difference between the receive and
+  // send times seen (the shortest network delay) over a window of packets.
+  struct sockaddr_in _coordinator;
+  int64_t _clock_offset,
+          _window_offset;
+  int _window_count;
+  uint32_t _back_frame,
+           _ready_frame,
+           _frame;
+  uint64_t _back_present,
+           _ready_present,
+           _present_time;
+  int64_t _ready_offset,
+          _frame_offset;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  std::atomic<bool> _stopping;
+  std::thread _thread;
+};
+
+#endif
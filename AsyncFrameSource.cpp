@@ -0,0 +1,157 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that captures from another source on its own thread, so a
+// stalled capture can not hold up the display.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "AsyncFrameSource.h"
+
+using namespace std;
+
+void AsyncFrameSource::Frame::take(FrameSource& source) {
+  if (swapData(source)) {
+    return;
+  }
+  // The reopened source has a different size (like after a change of the
+  // HDMI mode), copy what overlaps and leave the rest of the frame as it was.
+  const int width = min(_width, source.width());
+  const int height = min(_height, source.height());
+  for (int y=0; y<height; ++y) {
+    memcpy(_data + y*_pitch, source.getRow(y), width*3);
+  }
+}
+
+AsyncFrameSource::AsyncFrameSource(const function<FrameSource*()>& open,
+                                   int deadline_ms, int max_failures):
+  _open(open),
+  _deadline((uint64_t)deadline_ms*1000),
+  _max_failures(max_failures),
+  _source(open()),
+  _back(_source->width(), _source->height(), _source->pitch()),
+  _requested(false),
+  _busy(false),
+  _complete(false),
+  _stalled(false),
+  _stopping(false),
+  _reopen_failed(false),
+  _failures(0),
+  _stalls(0),
+  _failed(0),
+  _reopens(0),
+  _stall_times("stall")
+{
+  allocate(_source->width(), _source->height(), _source->pitch());
+  _thread = thread(&AsyncFrameSource::run, this);
+}
+
+AsyncFrameSource::~AsyncFrameSource() {
+  {
+    lock_guard<mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _condition.notify_all();
+  // A capture stuck in the driver holds this up until it returns.
+  _thread.join();
+}
+
+bool AsyncFrameSource::capture() {
+  unique_lock<mutex> lock(_mutex);
+  // Start a capture unless one is still running from an earlier call or a
+  // late frame is already waiting.
+  if (!_busy && !_complete) {
+    _requested = true;
+    _busy = true;
+    _stalled = false;
+    _condition.notify_all();
+  }
+  _condition.wait_for(lock, chrono::microseconds(_deadline),
+                      [this] { return _complete || !_busy; });
+  if (_complete) {
+    swapData(_back);
+    _complete = false;
+    return true;
+  }
+  if (_busy && !_stalled) {
+    // Count each capture that misses its deadline once, its duration is
+    // recorded when it finally returns.
+    _stalled = true;
+    ++_stalls;
+  }
+  return false;
+}
+
+void AsyncFrameSource::printStats(ostream& out) {
+  lock_guard<mutex> lock(_mutex);
+  if ((_stalls == 0) && (_failed == 0) && (_reopens == 0)) {
+    return;
+  }
+  out << "Capture: " << _stalls << " stalls, " << _failed << " failures, "
+      << _reopens << " reopens" << endl;
+  _stall_times.print(out);
+  _stalls = _failed = _reopens = 0;
+  _stall_times.clear();
+}
+
+void AsyncFrameSource::run() {
+  unique_lock<mutex> lock(_mutex);
+  while (true) {
+    _condition.wait(lock, [this] { return _requested || _stopping; });
+    if (_stopping) {
+      break;
+    }
+    _requested = false;
+    lock.unlock();
+
+    // Capture without holding the lock, this is the part that can stall.
+    uint64_t start = LatencyStats::now();
+    bool captured = _source && _source->capture();
+    uint64_t duration = LatencyStats::now() - start;
+    if (captured) {
+      _back.take(*_source);
+    }
+
+    lock.lock();
+    if (duration > _deadline) {
+      _stall_times.add(duration);
+    }
+    _busy = false;
+    if (captured) {
+      _complete = true;
+      _failures = 0;
+    }
+    else {
+      ++_failed;
+      ++_failures;
+    }
+    _condition.notify_all();
+    if (_failures >= _max_failures) {
+      _failures = 0;
+      lock.unlock();
+      reopen();
+      lock.lock();
+    }
+  }
+}
+
+void AsyncFrameSource::reopen() {
+  // Close the source before opening it again so its resources (like the
+  // GPU surface) are freed first.  If it can not be opened captures keep
+  // failing until a later attempt succeeds.
+  _source.reset();
+  try {
+    _source.reset(_open());
+    _reopen_failed = false;
+  }
+  catch (const exception& ex) {
+    // Only report the first of a run of failed attempts.
+    if (!_reopen_failed) {
+      cerr << "Unable to reopen frame source: " << ex.what() << endl;
+    }
+    _reopen_failed = true;
+  }
+  lock_guard<mutex> lock(_mutex);
+  ++_reopens;
+}
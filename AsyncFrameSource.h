@@ -0,0 +1,77 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that captures from another source on its own thread, so a
+// stalled capture can not hold up the display.
+#ifndef ASYNCFRAMESOURCE_H
+#define ASYNCFRAMESOURCE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "FrameSource.h"
+#include "LatencyStats.h"
+
+// Each capture() asks the thread to capture a frame from the wrapped source
+// and waits for it up to the deadline.  If the capture runs late (or fails)
+// capture() returns false and the last good frame is kept, so the output
+// keeps presenting it, and a late frame is picked up by the next call once
+// it arrives.  Frames are handed over by swapping buffers with the wrapped
+// source.  After max_failures failed captures in a row the wrapped source is
+// closed and opened again with the open function.
+class AsyncFrameSource: public FrameSource {
+public:
+  AsyncFrameSource(const std::function<FrameSource*()>& open, int deadline_ms,
+                   int max_failures = 3);
+  virtual ~AsyncFrameSource();
+
+  virtual bool capture();
+
+  // Print and reset the stall, failure and reopen statistics.  Nothing is
+  // printed if every capture since the last call made its deadline.
+  void printStats(std::ostream& out);
+
+private:
+  // Buffer for a finished frame waiting to be taken by capture().
+  class Frame: public FrameSource {
+  public:
+    Frame(int width, int height, int pitch) {
+      allocate(width, height, pitch);
+    }
+    virtual bool capture() {
+      return true;
+    }
+    // Take the frame of a source, swapping buffers with it when the sizes
+    // match and otherwise copying the part that fits.
+    void take(FrameSource& source);
+  };
+
+  void run();
+  void reopen();
+
+  std::function<FrameSource*()> _open;
+  const uint64_t _deadline;
+  const int _max_failures;
+  std::unique_ptr<FrameSource> _source;
+  Frame _back;
+  bool _requested,
+       _busy,
+       _complete,
+       _stalled,
+       _stopping,
+       _reopen_failed;
+  int _failures;
+  // Statistics since they were last printed.
+  int _stalls,
+      _failed,
+      _reopens;
+  LatencyStats _stall_times;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  std::thread _thread;
+};
+
+#endif
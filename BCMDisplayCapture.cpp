@@ -0,0 +1,63 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that captures an image of the Pi's primary display.
+#include <iostream>
+#include <stdexcept>
+
+#include "BCMDisplayCapture.h"
+
+using namespace std;
+
+BCMDisplayCapture::BCMDisplayCapture(int width, int height,
+                                     DISPMANX_TRANSFORM_T transform):
+  _display(0),
+  _screen_resource(0),
+  _transform(transform)
+{
+  // Get information about primary/HDMI display.
+  _display = vc_dispmanx_display_open(0);
+  if (!_display) {
+    throw runtime_error("Unable to open primary display!");
+  }
+  DISPMANX_MODEINFO_T display_info;
+  if (vc_dispmanx_display_get_info(_display, &display_info)) {
+    throw runtime_error("Unable to get primary display information!");
+  }
+  cout << "Primary display:" << endl
+       << " resolution: " << display_info.width << "x" << display_info.height << endl
+       << " format: " << display_info.input_format << endl;
+  // If no width and height were specified then grab the entire screen.
+  if ((width == -1) || (height == -1)) {
+    width = display_info.width;
+    height = display_info.height;
+  }
+  // Create a GPU image surface to hold the captured screen.
+  uint32_t image_prt;
+  _screen_resource = vc_dispmanx_resource_create(VC_IMAGE_RGB888, width, height, &image_prt);
+  if (!_screen_resource) {
+    throw runtime_error("Unable to create screen surface!");
+  }
+  // Create a rectangular region of the captured screen size.
+  vc_dispmanx_rect_set(&_rect, 0, 0, width, height);
+  // Allocate CPU memory for copying out the captured screen.  Must be aligned
+  // to a larger size because of GPU surface memory size constraints.
+  allocate(width, height, ALIGN_UP(width*3, 32));
+}
+
+BCMDisplayCapture::~BCMDisplayCapture() {
+  // Clean up BCM resources, the frame buffer is freed by FrameSource.
+  if (_screen_resource != 0) {
+    vc_dispmanx_resource_delete(_screen_resource);
+  }
+  if (_display != 0) {
+    vc_dispmanx_display_close(_display);
+  }
+}
+
+bool BCMDisplayCapture::capture() {
+  // Capture the primary display and copy it from GPU to CPU memory.  Both
+  // fail (for example while the HDMI mode changes) by returning non-zero.
+  if (vc_dispmanx_snapshot(_display, _screen_resource, _transform) != 0) {
+    return false;
+  }
+  return vc_dispmanx_resource_read_data(_screen_resource, &_rect, _data, _pitch) == 0;
+}
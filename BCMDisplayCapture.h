@@ -0,0 +1,29 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that captures an image of the Pi's primary display.
+#ifndef BCMDISPLAYCAPTURE_H
+#define BCMDISPLAYCAPTURE_H
+
+#include <bcm_host.h>
+
+#include "FrameSource.h"
+
+// Class to encapsulate all the logic for capturing an image of the Pi's primary
+// display.  Manages all the BCM GPU and CPU resources automatically while in scope.
+class BCMDisplayCapture: public FrameSource {
+public:
+  // The transform flips the captured image on the GPU (the snapshot only
+  // supports DISPMANX_FLIP_HRIZ and DISPMANX_FLIP_VERT).
+  BCMDisplayCapture(int width=-1, int height=-1,
+                    DISPMANX_TRANSFORM_T transform=DISPMANX_NO_ROTATE);
+  virtual ~BCMDisplayCapture();
+
+  virtual bool capture();
+
+private:
+  DISPMANX_DISPLAY_HANDLE_T _display;
+  DISPMANX_RESOURCE_HANDLE_T _screen_resource;
+  VC_RECT_T _rect;
+  DISPMANX_TRANSFORM_T _transform;
+};
+
+#endif
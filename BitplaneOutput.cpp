@@ -0,0 +1,424 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Converts whole frames straight into the matrix library's framebuffer,
+// bypassing the per-pixel SetPixel path.
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "BitplaneOutput.h"
+
+using namespace std;
+using namespace rgb_matrix;
+
+namespace {
+
+// A framebuffer word that differs from the cleared framebuffer.
+struct Change {
+  uint32_t word;
+  uint32_t bits;
+};
+
+// A GPIO bit of the framebuffer and the matrix pixel and color driving it.
+struct Source {
+  uint32_t word;
+  int bit,
+      color,
+      pixel;
+
+  bool operator<(const Source& other) const {
+    return (word != other.word) ? (word < other.word) : (bit < other.bit);
+  }
+};
+
+const uint32_t* serialize(const FrameCanvas* canvas, size_t* size) {
+  const char* data;
+  canvas->Serialize(&data, size);
+  return reinterpret_cast<const uint32_t*>(data);
+}
+
+vector<Change> changes(const FrameCanvas* canvas, const vector<uint32_t>& base) {
+  size_t size;
+  const uint32_t* words = serialize(canvas, &size);
+  vector<Change> result;
+  for (size_t i=0; i<base.size(); ++i) {
+    if (words[i] != base[i]) {
+      Change change = { (uint32_t)i, words[i] ^ base[i] };
+      result.push_back(change);
+    }
+  }
+  return result;
+}
+
+// Transpose an 8x8 bit matrix held one row per byte, so bit j of byte i
+// moves to bit i of byte j.
+inline uint64_t transpose8(uint64_t x) {
+  uint64_t t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x ^= t ^ (t << 28);
+  return x;
+}
+
+}
+
+BitplaneOutput::BitplaneOutput(RGBMatrix* matrix, GridTransformer* grid,
+                               int threads):
+  _scratch(matrix->CreateFrameCanvas()),
+  _grid(grid),
+  _threads(max(1, threads)),
+  _slots(0),
+  _planes(0),
+  _frame(NULL),
+  _generation(0),
+  _remaining(0),
+  _stopping(false)
+{
+  const int matrix_width = _scratch->width();
+  const int matrix_height = _scratch->height();
+  _width = (grid != NULL) ? grid->width() : matrix_width;
+  _height = (grid != NULL) ? grid->height() : matrix_height;
+  _scratch->Clear();
+  size_t size;
+  const uint32_t* words = serialize(_scratch, &size);
+  if ((size == 0) || (size % sizeof(uint32_t) != 0) || (matrix_width <= 0)) {
+    throw runtime_error("The matrix library can not serialize its framebuffer!");
+  }
+  _base.assign(words, words + size/sizeof(uint32_t));
+
+  // Find the GPIO bit of every bitplane of each color from the bits the top
+  // left pixel changes over all of its values.
+  vector<Change> probes[3][256];
+  vector<Source> planes[3];
+  for (int color=0; color<3; ++color) {
+    for (int value=0; value<256; ++value) {
+      uint8_t rgb[3] = { 0, 0, 0 };
+      rgb[color] = value;
+      _scratch->SetPixel(0, 0, rgb[0], rgb[1], rgb[2]);
+      probes[color][value] = changes(_scratch, _base);
+      for (auto& change: probes[color][value]) {
+        for (int bit=0; bit<32; ++bit) {
+          if (change.bits & (1u << bit)) {
+            Source plane = { change.word, bit, color, 0 };
+            planes[color].push_back(plane);
+          }
+        }
+      }
+    }
+    sort(planes[color].begin(), planes[color].end());
+    planes[color].erase(unique(planes[color].begin(), planes[color].end(),
+                               [](const Source& a, const Source& b) {
+                                 return !(a < b) && !(b < a);
+                               }),
+                        planes[color].end());
+  }
+  _scratch->Clear();
+  _planes = planes[0].size();
+  if ((_planes == 0) || (_planes > 16)) {
+    throw runtime_error("Unexpected number of bitplanes in the matrix framebuffer!");
+  }
+  for (int color=0; color<3; ++color) {
+    if ((int)planes[color].size() != _planes) {
+      throw runtime_error("Colors have different bitplanes in the matrix framebuffer!");
+    }
+    for (int k=0; k<_planes; ++k) {
+      const Source& plane = planes[color][k];
+      const int offset = plane.word - planes[color][0].word;
+      if (color == 0) {
+        _plane_offsets.push_back(offset);
+      }
+      if ((plane.bit != planes[color][0].bit) ||
+          ((k > 0) && (plane.word == planes[color][k-1].word)) ||
+          (offset != _plane_offsets[k])) {
+        throw runtime_error("Bitplanes of a pixel are not evenly laid out in the matrix framebuffer!");
+      }
+    }
+    for (int value=0; value<256; ++value) {
+      _planes_for[color][value] = 0;
+      for (auto& change: probes[color][value]) {
+        for (int k=0; k<_planes; ++k) {
+          if (change.word == planes[color][k].word) {
+            _planes_for[color][value] |= 1 << k;
+          }
+        }
+      }
+    }
+  }
+
+  // Pick a value that sets a single bitplane, the same for all colors, so
+  // every GPIO bit shows up just once in the frames below.
+  int probe_value = -1;
+  int probe_plane = 0;
+  for (int value=1; (value<256) && (probe_value < 0); ++value) {
+    const uint16_t mask = _planes_for[0][value];
+    if ((mask != 0) && ((mask & (mask - 1)) == 0) &&
+        (_planes_for[1][value] == mask) && (_planes_for[2][value] == mask)) {
+      probe_value = value;
+      while ((mask >> probe_plane) != 1) {
+        ++probe_plane;
+      }
+    }
+  }
+  if (probe_value < 0) {
+    throw runtime_error("No color value sets a single bitplane of the matrix framebuffer!");
+  }
+
+  // Find the color driving each GPIO bit with a frame of each color, then
+  // the pixel with a frame for each bit of the pixel index lighting the
+  // pixels that have it set.
+  const int pixels = matrix_width*matrix_height;
+  vector<Source> sources;
+  for (int color=0; color<3; ++color) {
+    uint8_t rgb[3] = { 0, 0, 0 };
+    rgb[color] = probe_value;
+    for (int y=0; y<matrix_height; ++y) {
+      for (int x=0; x<matrix_width; ++x) {
+        _scratch->SetPixel(x, y, rgb[0], rgb[1], rgb[2]);
+      }
+    }
+    for (auto& change: changes(_scratch, _base)) {
+      for (int bit=0; bit<32; ++bit) {
+        if (change.bits & (1u << bit)) {
+          Source source = { change.word, bit, color, 0 };
+          sources.push_back(source);
+        }
+      }
+    }
+    _scratch->Clear();
+  }
+  sort(sources.begin(), sources.end());
+  for (size_t i=1; i<sources.size(); ++i) {
+    if (!(sources[i-1] < sources[i])) {
+      throw runtime_error("A GPIO bit of the matrix framebuffer is driven by several colors!");
+    }
+  }
+  for (int index_bit=0; (1 << index_bit) < pixels; ++index_bit) {
+    for (int y=0; y<matrix_height; ++y) {
+      for (int x=0; x<matrix_width; ++x) {
+        if ((y*matrix_width + x) & (1 << index_bit)) {
+          _scratch->SetPixel(x, y, probe_value, probe_value, probe_value);
+        }
+      }
+    }
+    for (auto& change: changes(_scratch, _base)) {
+      for (int bit=0; bit<32; ++bit) {
+        if (change.bits & (1u << bit)) {
+          Source key = { change.word, bit, 0, 0 };
+          auto source = lower_bound(sources.begin(), sources.end(), key);
+          if ((source == sources.end()) || (key < *source)) {
+            throw runtime_error("Unexpected GPIO bit set in the matrix framebuffer!");
+          }
+          source->pixel |= 1 << index_bit;
+        }
+      }
+    }
+    _scratch->Clear();
+  }
+
+  // Where each matrix pixel is taken from in a frame.
+  vector<int> frame_offsets(pixels, -1);
+  for (int y=0; y<_height; ++y) {
+    for (int x=0; x<_width; ++x) {
+      int matrix_x = x;
+      int matrix_y = y;
+      if (((grid == NULL) || grid->mapPixel(x, y, &matrix_x, &matrix_y)) &&
+          (matrix_x >= 0) && (matrix_y >= 0) &&
+          (matrix_x < matrix_width) && (matrix_y < matrix_height)) {
+        frame_offsets[matrix_y*matrix_width + matrix_x] = (y*_width + x)*3;
+      }
+    }
+  }
+
+  // Give every GPIO bit a slot, and group the sources by the word they set
+  // in the first bitplane.
+  int slot_of[32];
+  fill(slot_of, slot_of + 32, -1);
+  for (auto& source: sources) {
+    slot_of[source.bit] = 0;
+  }
+  for (int bit=0; bit<32; ++bit) {
+    if (slot_of[bit] == 0) {
+      slot_of[bit] = _slots++;
+      _slot_colors.push_back(-1);
+    }
+  }
+  const int first_offset = _plane_offsets[probe_plane];
+  const int last_offset = _plane_offsets[_planes - 1];
+  for (auto& source: sources) {
+    const int slot = slot_of[source.bit];
+    if (((_slot_colors[slot] >= 0) && (_slot_colors[slot] != source.color)) ||
+        (source.pixel >= pixels) || ((int)source.word < first_offset) ||
+        (source.word - first_offset + last_offset >= _base.size())) {
+      throw runtime_error("Unexpected GPIO bit layout in the matrix framebuffer!");
+    }
+    _slot_colors[slot] = source.color;
+    const uint32_t word = source.word - first_offset;
+    if (_group_words.empty() || (_group_words.back() != word)) {
+      _group_words.push_back(word);
+      _group_offsets.resize(_group_offsets.size() + _slots, -1);
+    }
+    const int offset = frame_offsets[source.pixel];
+    _group_offsets[_group_offsets.size() - _slots + slot] =
+      (offset < 0) ? -1 : offset + source.color;
+  }
+  _scatter.resize(((_slots + 7) / 8)*256, 0);
+  for (int slot=0; slot<_slots; ++slot) {
+    int bit = 0;
+    while (slot_of[bit] != slot) {
+      ++bit;
+    }
+    for (int byte=0; byte<256; ++byte) {
+      if (byte & (1 << (slot % 8))) {
+        _scatter[(slot / 8)*256 + byte] |= 1u << bit;
+      }
+    }
+  }
+  _buffer = _base;
+
+  for (int i=1; i<_threads; ++i) {
+    _workers.push_back(thread(&BitplaneOutput::run, this, i));
+  }
+}
+
+BitplaneOutput::~BitplaneOutput() {
+  {
+    lock_guard<mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _start.notify_all();
+  for (auto& worker: _workers) {
+    worker.join();
+  }
+}
+
+void BitplaneOutput::convert(int first_group, int last_group) {
+  const uint8_t* frame = _frame;
+  const int blocks = (_slots + 7) / 8;
+  for (int group=first_group; group<last_group; ++group) {
+    // Gather the bitplane masks of the colors in the group's slots, 8 slots
+    // to a 64-bit word, and transpose them so each byte holds one bitplane.
+    const int* offsets = &_group_offsets[group*_slots];
+    uint64_t low[4] = { 0, 0, 0, 0 };
+    uint64_t high[4] = { 0, 0, 0, 0 };
+    for (int slot=0; slot<_slots; ++slot) {
+      const uint8_t value = (offsets[slot] < 0) ? 0 : frame[offsets[slot]];
+      const uint16_t mask = _planes_for[_slot_colors[slot]][value];
+      low[slot / 8] |= (uint64_t)(mask & 0xFF) << ((slot % 8)*8);
+      high[slot / 8] |= (uint64_t)(mask >> 8) << ((slot % 8)*8);
+    }
+    for (int block=0; block<blocks; ++block) {
+      low[block] = transpose8(low[block]);
+      if (_planes > 8) {
+        high[block] = transpose8(high[block]);
+      }
+    }
+    // Turn each bitplane's byte of slots into GPIO bits.
+    const uint32_t word = _group_words[group];
+    for (int k=0; k<_planes; ++k) {
+      const uint64_t* planes = (k < 8) ? low : high;
+      const int shift = (k % 8)*8;
+      uint32_t bits = 0;
+      for (int block=0; block<blocks; ++block) {
+        bits |= _scatter[block*256 + ((planes[block] >> shift) & 0xFF)];
+      }
+      const uint32_t index = word + _plane_offsets[k];
+      _buffer[index] = _base[index] ^ bits;
+    }
+  }
+}
+
+void BitplaneOutput::run(int index) {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      unique_lock<mutex> lock(_mutex);
+      _start.wait(lock, [&] { return _stopping || (_generation != generation); });
+      if (_stopping) {
+        return;
+      }
+      generation = _generation;
+    }
+    const int groups = _group_words.size();
+    convert(groups*index/_threads, groups*(index + 1)/_threads);
+    {
+      lock_guard<mutex> lock(_mutex);
+      --_remaining;
+    }
+    _done.notify_one();
+  }
+}
+
+void BitplaneOutput::write(const MemoryCanvas& frame, FrameCanvas* canvas) {
+  if ((frame.width() != _width) || (frame.height() != _height)) {
+    throw invalid_argument("Frame size does not match the direct output!");
+  }
+  _frame = frame.getRow(0);
+  if (!_workers.empty()) {
+    {
+      lock_guard<mutex> lock(_mutex);
+      ++_generation;
+      _remaining = _workers.size();
+    }
+    _start.notify_all();
+  }
+  convert(0, _group_words.size()/_threads);
+  if (!_workers.empty()) {
+    unique_lock<mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _remaining == 0; });
+  }
+  canvas->Deserialize(reinterpret_cast<const char*>(&_buffer[0]),
+                      _buffer.size()*sizeof(uint32_t));
+}
+
+bool BitplaneOutput::verify() {
+  // Random noise, every value of each color and full white.
+  MemoryCanvas frame(_width, _height);
+  uint32_t state = 2463534242u;
+  for (int test=0; test<3; ++test) {
+    for (int y=0; y<_height; ++y) {
+      for (int x=0; x<_width; ++x) {
+        const int i = y*_width + x;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if (test == 0) {
+          frame.SetPixel(x, y, state, state >> 8, state >> 16);
+        }
+        else if (test == 1) {
+          frame.SetPixel(x, y, i, i*7, 255 - i);
+        }
+        else {
+          frame.SetPixel(x, y, 255, 255, 255);
+        }
+      }
+    }
+    _scratch->Clear();
+    if (_grid != NULL) {
+      _grid->Transform(_scratch);
+      for (int y=0; y<_height; ++y) {
+        _grid->drawRow(0, y, frame.getRow(y), _width);
+      }
+    }
+    else {
+      for (int y=0; y<_height; ++y) {
+        for (int x=0; x<_width; ++x) {
+          uint8_t r, g, b;
+          frame.getPixel(x, y, &r, &g, &b);
+          _scratch->SetPixel(x, y, r, g, b);
+        }
+      }
+    }
+    size_t size;
+    const uint32_t* words = serialize(_scratch, &size);
+    vector<uint32_t> expected(words, words + size/sizeof(uint32_t));
+    write(frame, _scratch);
+    words = serialize(_scratch, &size);
+    if ((expected.size() != _buffer.size()) ||
+        !equal(expected.begin(), expected.end(), words)) {
+      return false;
+    }
+  }
+  return true;
+}
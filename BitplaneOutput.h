@@ -0,0 +1,95 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Converts whole frames straight into the matrix library's framebuffer,
+// bypassing the per-pixel SetPixel path.
+#ifndef BITPLANEOUTPUT_H
+#define BITPLANEOUTPUT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "led-matrix.h"
+
+#include "GridTransformer.h"
+#include "MemoryCanvas.h"
+
+// The matrix library keeps a frame canvas as bitplanes: for every PWM bit a
+// run of GPIO words, each of which holds one bit of a color of the pixels
+// clocked out together on every parallel chain.  That layout is internal to
+// the library, so it is learned when constructing by setting pixels on a
+// scratch canvas and reading it back with Serialize:
+//  - the words and bits a single pixel changes for every color value give
+//    the value to bitplane table and the word offset between the bitplanes,
+//  - full frames of one bitplane show which pixel and color drives every
+//    GPIO bit, with the pixel index coded in binary over as many frames.
+// Each frame is then written one group of GPIO words at a time, transposing
+// the bitplane masks of the colors driving the group 8x8 bits at a time
+// into whole words, and loaded into the canvas with Deserialize.  Groups are
+// in framebuffer order, which is by scan row, so the threads each convert a
+// batch of rows.
+class BitplaneOutput {
+public:
+  // Frames are the size of the grid, or of the matrix when grid is NULL.
+  // Throws runtime_error if the framebuffer does not fit the model above.
+  BitplaneOutput(rgb_matrix::RGBMatrix* matrix, GridTransformer* grid,
+                 int threads);
+  ~BitplaneOutput();
+
+  int width() const {
+    return _width;
+  }
+  int height() const {
+    return _height;
+  }
+  int getThreads() const {
+    return _threads;
+  }
+
+  // Convert a frame and load it into the canvas, which must belong to the
+  // matrix this output was created for.
+  void write(const MemoryCanvas& frame, rgb_matrix::FrameCanvas* canvas);
+
+  // Draw test frames both with SetPixel and with write, returning true if
+  // the framebuffers are bit identical.
+  bool verify();
+
+private:
+  void convert(int first_group, int last_group);
+  void run(int index);
+
+  rgb_matrix::FrameCanvas* _scratch;
+  GridTransformer* _grid;
+  int _width,
+      _height,
+      _threads,
+      _slots,
+      _planes;
+  // Framebuffer after Clear, and the one written for each frame.
+  std::vector<uint32_t> _base,
+                        _buffer;
+  // Offset of each bitplane's word from a group's word.
+  std::vector<int> _plane_offsets;
+  // Bits of the bitplanes a color value sets, for red, green and blue.
+  uint16_t _planes_for[3][256];
+  // Color driving each slot, and for every 8 slots the GPIO bits each byte
+  // of their transposed bitplane masks sets.
+  std::vector<int> _slot_colors;
+  std::vector<uint32_t> _scatter;
+  // Word of each group and the frame offset of the color in each of its
+  // slots, or -1 for none.
+  std::vector<uint32_t> _group_words;
+  std::vector<int> _group_offsets;
+  // Threads converting the other batches of groups.
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _start,
+                          _done;
+  const uint8_t* _frame;
+  uint64_t _generation;
+  int _remaining;
+  bool _stopping;
+};
+
+#endif
@@ -0,0 +1,132 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Composes regions of a captured frame onto the LED display.
+#include <algorithm>
+
+#include "Compositor.h"
+#include "GridTransformer.h"
+#include "MemoryCanvas.h"
+
+using namespace rgb_matrix;
+using namespace std;
+
+Compositor::Compositor(int display_width, int display_height,
+                       const vector<Window>& windows):
+  _display_width(display_width),
+  _display_height(display_height),
+  _windows(windows),
+  _row(display_width*3, 0),
+  _black(display_width*3, 0),
+  _dither(NULL)
+{}
+
+void Compositor::plan(int source_width, int source_height) {
+  _copies.clear();
+  for (auto& window: _windows) {
+    // Clip the window to both the source frame and the display, so render
+    // never has to check bounds.  Blocks of scaled pixels that only partly
+    // fit on the right or bottom edge of the display are cut short.
+    int scale = window.scale;
+    int x0 = max(0, max(-window.source_x, (-window.dest_x + scale - 1) / scale));
+    int x1 = min(window.width,
+                 min(source_width - window.source_x,
+                     (_display_width - window.dest_x + scale - 1) / scale));
+    int y0 = max(0, max(-window.source_y, (-window.dest_y + scale - 1) / scale));
+    int y1 = min(window.height,
+                 min(source_height - window.source_y,
+                     (_display_height - window.dest_y + scale - 1) / scale));
+    for (int y=y0; y<y1; ++y) {
+      RowCopy copy;
+      copy.source_x = window.source_x + x0;
+      copy.source_y = window.source_y + y;
+      copy.dest_x = window.dest_x + x0*scale;
+      copy.dest_y = window.dest_y + y*scale;
+      copy.dest_width = min((x1 - x0)*scale, _display_width - copy.dest_x);
+      copy.dest_height = min(scale, _display_height - copy.dest_y);
+      copy.scale = scale;
+      if (copy.dest_width > 0) {
+        _copies.push_back(copy);
+      }
+    }
+  }
+
+  // Find the runs of each display row that no copy covers.
+  _gaps.clear();
+  vector<bool> covered(_display_width*_display_height, false);
+  for (auto& copy: _copies) {
+    for (int y=copy.dest_y; y<copy.dest_y+copy.dest_height; ++y) {
+      fill(covered.begin() + y*_display_width + copy.dest_x,
+           covered.begin() + y*_display_width + copy.dest_x + copy.dest_width,
+           true);
+    }
+  }
+  for (int y=0; y<_display_height; ++y) {
+    for (int x=0; x<_display_width; ) {
+      if (covered[y*_display_width + x]) {
+        ++x;
+        continue;
+      }
+      RowCopy gap = { 0, 0, x, y, 0, 1, 1 };
+      while ((x < _display_width) && !covered[y*_display_width + x]) {
+        ++x;
+      }
+      gap.dest_width = x - gap.dest_x;
+      _gaps.push_back(gap);
+    }
+  }
+}
+
+// Rows are drawn whole when the canvas is a GridTransformer, so the panel
+// mapping is looked up once per panel instead of once per pixel, or a
+// MemoryCanvas, where they are copied straight into its pixels.
+static void drawRow(Canvas* canvas, GridTransformer* grid, MemoryCanvas* memory,
+                    int x, int y, const uint8_t* pixels, int count) {
+  if (grid != NULL) {
+    grid->drawRow(x, y, pixels, count);
+    return;
+  }
+  if (memory != NULL) {
+    memory->drawRow(x, y, pixels, count);
+    return;
+  }
+  for (int i=0; i<count; ++i, pixels+=3) {
+    canvas->SetPixel(x + i, y, pixels[0], pixels[1], pixels[2]);
+  }
+}
+
+void Compositor::render(const FrameSource& source, Canvas* canvas) {
+  GridTransformer* grid = dynamic_cast<GridTransformer*>(canvas);
+  MemoryCanvas* memory = dynamic_cast<MemoryCanvas*>(canvas);
+  if (_dither != NULL) {
+    _dither->nextFrame();
+  }
+  for (auto& gap: _gaps) {
+    drawRow(canvas, grid, memory, gap.dest_x, gap.dest_y, &_black[0],
+            gap.dest_width);
+  }
+  for (auto& copy: _copies) {
+    const uint8_t* source_row = source.getRow(copy.source_y) + copy.source_x*3;
+    for (int j=0; j<copy.dest_height; ++j) {
+      const int y = copy.dest_y + j;
+      const uint8_t* row = source_row;
+      if ((copy.scale > 1) || (_dither != NULL)) {
+        // Replicate each source pixel scale times across the scratch row, then
+        // draw that same row scale times down the display.  When dithering the
+        // pattern differs from row to row so the scratch row is redone.
+        if ((j == 0) || (_dither != NULL)) {
+          uint8_t* wide = &_row[0];
+          for (int i=0; i<copy.dest_width; ++i, wide+=3) {
+            const uint8_t* pixel = source_row + (i / copy.scale)*3;
+            wide[0] = pixel[0];
+            wide[1] = pixel[1];
+            wide[2] = pixel[2];
+            if (_dither != NULL) {
+              _dither->apply(copy.dest_x + i, y, &wide[0], &wide[1], &wide[2]);
+            }
+          }
+        }
+        row = &_row[0];
+      }
+      drawRow(canvas, grid, memory, copy.dest_x, y, row, copy.dest_width);
+    }
+  }
+}
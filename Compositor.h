@@ -0,0 +1,76 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Composes regions of a captured frame onto the LED display.
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <vector>
+
+#include "Dither.h"
+#include "FrameSource.h"
+#include "led-matrix.h"
+
+class Compositor {
+public:
+  // A rectangle of the source frame and where it goes on the display, where
+  // every source pixel becomes a scale x scale block.
+  struct Window {
+    int source_x,
+        source_y,
+        width,
+        height,
+        dest_x,
+        dest_y,
+        scale;
+  };
+
+  Compositor(int display_width, int display_height,
+             const std::vector<Window>& windows);
+
+  // Plan the row copies for frames of the given size.  Must be called before
+  // render and again whenever the size of the source frames changes.
+  void plan(int source_width, int source_height);
+
+  // Copy all the windows of a frame to the canvas, and clear the parts of
+  // the display no window covers.  The canvas may be one of several frame
+  // buffers, so those parts would otherwise keep what was drawn there before.
+  void render(const FrameSource& source, rgb_matrix::Canvas* canvas);
+
+  // Dither every pixel that is copied, or no dithering if NULL.  The dither
+  // pattern moves on for each rendered frame.
+  void setDither(Dither* dither) {
+    _dither = dither;
+  }
+
+  const std::vector<Window>& getWindows() const {
+    return _windows;
+  }
+
+private:
+  // One row of a window, copied to a dest_width x dest_height block of the
+  // display (scale rows high, unless clipped by the display edge).
+  struct RowCopy {
+    int source_x,
+        source_y,
+        dest_x,
+        dest_y,
+        dest_width,
+        dest_height,
+        scale;
+  };
+
+  int _display_width,
+      _display_height;
+  std::vector<Window> _windows;
+  std::vector<RowCopy> _copies;
+  // Runs of display pixels that no row copy covers, as a row copy without a
+  // source.
+  std::vector<RowCopy> _gaps;
+  // Scratch row that scaled or dithered rows are prepared in before being
+  // drawn.
+  std::vector<uint8_t> _row;
+  // Row of black pixels the gaps are cleared with.
+  std::vector<uint8_t> _black;
+  Dither* _dither;
+};
+
+#endif
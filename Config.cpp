@@ -26,7 +26,12 @@ Config::Config(rgb_matrix::RGBMatrix::Options *options,
     _display_height(-1),
     _panel_width(-1),
     _crop_x(-1),
-    _crop_y(-1)
+    _crop_y(-1),
+    _capture_scale(1),
+    _capture_deadline_ms(50),
+    _frame_interpolation(1),
+    _direct_output_threads(0),
+    _dither(false)
 {
   try {
     // Load config file with libconfig.
@@ -52,6 +57,25 @@ Config::Config(rgb_matrix::RGBMatrix::Options *options,
     _display_height = getWithDefault(root, "display_height",
                                      getPanelHeight() * getParallelCount());
 
+    // Load optional transform of the whole display.  It has to be known
+    // before anything that depends on the display size is checked.
+    _transform.rotate = 0;
+    _transform.flip_horizontal = false;
+    _transform.flip_vertical = false;
+    if (root.exists("display_transform")) {
+      libconfig::Setting& transform = root["display_transform"];
+      _transform.rotate = getWithDefault(transform, "rotate", 0);
+      transform.lookupValue("flip_horizontal", _transform.flip_horizontal);
+      transform.lookupValue("flip_vertical", _transform.flip_vertical);
+      if ((_transform.rotate != 0) && (_transform.rotate != 90) &&
+          (_transform.rotate != 180) && (_transform.rotate != 270)) {
+        throw invalid_argument("display_transform rotate must be 0, 90, 180 or 270!");
+      }
+      if (isLayoutRotated() && (_panel_width != getPanelHeight())) {
+        throw invalid_argument("display_transform can only rotate by 90 or 270 degrees with square panels!");
+      }
+    }
+
     // Load optional crop_origin value.
     if (root.exists("crop_origin")) {
       libconfig::Setting& crop_origin = root["crop_origin"];
@@ -62,6 +86,152 @@ Config::Config(rgb_matrix::RGBMatrix::Options *options,
       _crop_y = crop_origin[1];
     }
 
+    // Load optional capture scale, each captured pixel becomes a block of
+    // capture_scale x capture_scale pixels on the display.
+    _capture_scale = getWithDefault(root, "capture_scale", 1);
+    if (_capture_scale < 1) {
+      throw invalid_argument("capture_scale must be 1 or more!");
+    }
+
+    // Load optional deadline for capturing the screen.
+    _capture_deadline_ms = getWithDefault(root, "capture_deadline_ms", 50);
+    if (_capture_deadline_ms < 0) {
+      throw invalid_argument("capture_deadline_ms must be 0 or more!");
+    }
+
+    // Load optional list of windows composed onto the display.
+    if (root.exists("windows")) {
+      if (root.exists("crop_origin")) {
+        throw invalid_argument("crop_origin and windows can not be used together!");
+      }
+      if (_capture_scale != 1) {
+        throw invalid_argument("capture_scale can not be used with windows, set a scale on each window instead!");
+      }
+      libconfig::Setting& windows_config = root["windows"];
+      for (int i = 0; i < windows_config.getLength(); ++i) {
+        libconfig::Setting& window_config = windows_config[i];
+        libconfig::Setting& source = window_config["source"];
+        libconfig::Setting& dest = window_config["dest"];
+        if ((source.getLength() != 4) || (dest.getLength() != 2)) {
+          stringstream error;
+          error << "Window " << i << " source must be a list of X, Y, width and height and dest a list of X and Y!";
+          throw invalid_argument(error.str());
+        }
+        Compositor::Window window;
+        window.source_x = source[0];
+        window.source_y = source[1];
+        window.width = source[2];
+        window.height = source[3];
+        window.dest_x = dest[0];
+        window.dest_y = dest[1];
+        window.scale = getWithDefault(window_config, "scale", 1);
+        if ((window.width <= 0) || (window.height <= 0) || (window.scale < 1)) {
+          stringstream error;
+          error << "Window " << i << " must have a positive size and scale!";
+          throw invalid_argument(error.str());
+        }
+        if ((window.source_x < 0) || (window.source_y < 0) ||
+            (window.dest_x < 0) || (window.dest_y < 0) ||
+            (window.dest_x + window.width*window.scale > getDisplayWidth()) ||
+            (window.dest_y + window.height*window.scale > getDisplayHeight())) {
+          stringstream error;
+          error << "Window " << i << " must fit inside the screen and the display!";
+          throw invalid_argument(error.str());
+        }
+        _windows.push_back(window);
+      }
+    }
+
+    // Load optional number of frames shown per captured frame.
+    _frame_interpolation = getWithDefault(root, "frame_interpolation", 1);
+    if ((_frame_interpolation < 1) || (_frame_interpolation > 4)) {
+      throw invalid_argument("frame_interpolation must be between 1 and 4!");
+    }
+
+    // Load optional number of threads for the direct framebuffer output.
+    _direct_output_threads = getWithDefault(root, "direct_output_threads", 0);
+    if ((_direct_output_threads < 0) || (_direct_output_threads > 4)) {
+      throw invalid_argument("direct_output_threads must be between 0 and 4!");
+    }
+
+    // Load optional dithering setting.
+    root.lookupValue("dither", _dither);
+
+    // Load optional Art-Net frame source settings.
+    _artnet.port = 0;
+    if (root.exists("artnet")) {
+      libconfig::Setting& artnet = root["artnet"];
+      _artnet.port = getWithDefault(artnet, "port", 6454);
+      _artnet.universe = getWithDefault(artnet, "universe", 0);
+      _artnet.timeout_ms = getWithDefault(artnet, "timeout_ms", 50);
+      if ((_artnet.port <= 0) || (_artnet.port > 65535)) {
+        throw invalid_argument("artnet port must be between 1 and 65535!");
+      }
+      if ((_artnet.universe < 0) || (_artnet.universe > 0x7FFF)) {
+        throw invalid_argument("artnet universe must be between 0 and 32767!");
+      }
+      if (_artnet.timeout_ms <= 0) {
+        throw invalid_argument("artnet timeout_ms must be positive!");
+      }
+      // Windows and the crop origin are in screen coordinates, there is no
+      // screen to take them from when frames come over the network.
+      if (root.exists("windows") || root.exists("crop_origin")) {
+        throw invalid_argument("artnet can not be used with windows or crop_origin!");
+      }
+      // Flips are only done by the GPU as the screen is captured, frames
+      // from the network can only be given a quarter turn.
+      if (_transform.flip_horizontal || _transform.flip_vertical ||
+          (_transform.rotate >= 180)) {
+        throw invalid_argument("artnet can only be used with a display_transform rotate of 0 or 90 and no flips!");
+      }
+    }
+
+    // Load optional shard settings, for a node of a sharded display.
+    if (root.exists("shard")) {
+      libconfig::Setting& shard = root["shard"];
+      _shard.host = "127.0.0.1";
+      shard.lookupValue("host", _shard.host);
+      _shard.x = getWithDefault(shard, "x", 0);
+      _shard.y = getWithDefault(shard, "y", 0);
+      if (!hasArtNetSource()) {
+        throw invalid_argument("shard needs an artnet port to receive its tile on!");
+      }
+      if ((_shard.x < 0) || (_shard.y < 0) || _shard.host.empty()) {
+        throw invalid_argument("shard must have a host and a non-negative x and y origin!");
+      }
+      if (root.exists("windows") || root.exists("crop_origin") ||
+          (_capture_scale != 1) || (_frame_interpolation != 1)) {
+        throw invalid_argument("shard can not be used with windows, crop_origin, capture_scale or frame_interpolation!");
+      }
+    }
+
+    // Load optional ticker settings.
+    if (root.exists("ticker")) {
+      libconfig::Setting& ticker = root["ticker"];
+      if (!ticker.lookupValue("text", _ticker.text) || _ticker.text.empty()) {
+        throw invalid_argument("ticker must have a non-empty text value!");
+      }
+      _ticker.scale = getWithDefault(ticker, "scale", 1);
+      _ticker.speed = getWithDefault(ticker, "speed", 1);
+      _ticker.y = getWithDefault(ticker, "y", getDisplayHeight() - 8*_ticker.scale);
+      _ticker.red = _ticker.green = _ticker.blue = 255;
+      if (ticker.exists("color")) {
+        libconfig::Setting& color = ticker["color"];
+        if (color.getLength() != 3) {
+          throw invalid_argument("ticker color must be a list with three values, the red, green and blue components!");
+        }
+        _ticker.red = color[0];
+        _ticker.green = color[1];
+        _ticker.blue = color[2];
+      }
+      if ((_ticker.scale < 1) || (_ticker.scale > 8)) {
+        throw invalid_argument("ticker scale must be between 1 and 8!");
+      }
+      if ((_ticker.y < 0) || (_ticker.y + 8*_ticker.scale > getDisplayHeight())) {
+        throw invalid_argument("ticker must fit inside the display height!");
+      }
+    }
+
     // Do basic validation of configuration.
     if (_panel_width % 32 != 0) {
       throw invalid_argument("Panel width must be multiple of 32. Typically that is 32, but sometimes 64.");
@@ -78,6 +248,10 @@ Config::Config(rgb_matrix::RGBMatrix::Options *options,
       throw invalid_argument(message);
     }
 
+    if (isLayoutRotated() && !root.exists("panels")) {
+      throw invalid_argument("display_transform can only rotate by 90 or 270 degrees with a panels list!");
+    }
+
     // Parse out the individual panel configurations.
     if (root.exists("panels")) {
       libconfig::Setting& panels_config = root["panels"];
@@ -125,6 +299,22 @@ Config::Config(rgb_matrix::RGBMatrix::Options *options,
         error << "Expected " << expected << " panels in configuration but found " << _panels.size() << "!";
         throw invalid_argument(error.str());
       }
+      // Fold a quarter turn of the display into the panel layout.  Turning
+      // the image clockwise puts the panel at row r and column c of the
+      // display at row c and column (columns - 1 - r) of the panels as
+      // mounted, and turns the panel itself by 90 degrees too.
+      if (isLayoutRotated()) {
+        const int rows = getDisplayHeight() / getPanelHeight();
+        const int cols = getDisplayWidth() / getPanelWidth();
+        vector<GridTransformer::Panel> mounted = _panels;
+        for (int r = 0; r < rows; ++r) {
+          for (int c = 0; c < cols; ++c) {
+            GridTransformer::Panel panel = mounted[c*rows + (rows - 1 - r)];
+            panel.rotate = (panel.rotate + 90) % 360;
+            _panels[r*cols + c] = panel;
+          }
+        }
+      }
     }
   }
   catch (const libconfig::FileIOException& fioex) {
@@ -145,3 +335,18 @@ Config::Config(rgb_matrix::RGBMatrix::Options *options,
     throw runtime_error("Error loading configuration!");
   }
 }
+
+vector<Compositor::Window> Config::getWindows() const {
+  if (hasWindows()) {
+    return _windows;
+  }
+  Compositor::Window window;
+  window.source_x = hasCropOrigin() ? _crop_x : 0;
+  window.source_y = hasCropOrigin() ? _crop_y : 0;
+  window.width = getCaptureWidth();
+  window.height = getCaptureHeight();
+  window.dest_x = 0;
+  window.dest_y = 0;
+  window.scale = _capture_scale;
+  return vector<Compositor::Window>(1, window);
+}
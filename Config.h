@@ -7,24 +7,59 @@
 #include <string>
 #include <vector>
 
+#include "Compositor.h"
 #include "GridTransformer.h"
 #include "led-matrix.h"
 
 class Config {
 public:
+  // Settings for receiving frames over the network with Art-Net instead of
+  // capturing the screen.
+  struct ArtNetSource {
+    int port,
+        universe,
+        timeout_ms;
+  };
+
+  // Flips and clockwise rotation from the screen to the display as mounted.
+  struct DisplayTransform {
+    int rotate;
+    bool flip_horizontal,
+         flip_vertical;
+  };
+
+  // Tile of a larger virtual display shown by this node of a sharded
+  // display.  The coordinator reads the origin of the tile in the virtual
+  // display and the host to send it to, the node itself only needs artnet.
+  struct Shard {
+    std::string host;
+    int x,
+        y;
+  };
+
+  // Scrolling text drawn over the display.
+  struct Ticker {
+    std::string text;
+    int y,
+        scale,
+        speed,
+        red,
+        green,
+        blue;
+  };
+
   Config(rgb_matrix::RGBMatrix::Options *options,
          const std::string& filename);
 
   // Attribute accessors:
+  // The display size is the size of the image drawn on the panels, which is
+  // turned on its side compared to the panels when the display is rotated by
+  // 90 or 270 degrees.
   int getDisplayWidth() const {
-    return (_display_width < 0)
-      ? getPanelWidth() * getChainLength()
-      : _display_width;
+    return isLayoutRotated() ? getPanelsHeight() : getPanelsWidth();
   }
   int getDisplayHeight() const {
-    return (_display_height < 0)
-      ? getPanelHeight() * getParallelCount()
-      : _display_height;
+    return isLayoutRotated() ? getPanelsWidth() : getPanelsHeight();
   }
   int getPanelWidth() const {
     return (_panel_width) < 0 ? 32 : _panel_width;
@@ -44,6 +79,22 @@ public:
                            getPanelWidth(), getPanelHeight(),
                            getChainLength(), _panels);
   }
+  const DisplayTransform& getDisplayTransform() const {
+    return _transform;
+  }
+  // The display transform is split between the GPU, which flips the screen
+  // as it is captured (a rotation by 180 degrees being both flips), and the
+  // panel layout, which takes any quarter turn that is left by moving and
+  // rotating the panels.
+  bool getSnapshotFlipHorizontal() const {
+    return _transform.flip_horizontal != (_transform.rotate >= 180);
+  }
+  bool getSnapshotFlipVertical() const {
+    return _transform.flip_vertical != (_transform.rotate >= 180);
+  }
+  bool isLayoutRotated() const {
+    return (_transform.rotate == 90) || (_transform.rotate == 270);
+  }
   bool hasCropOrigin() const {
     return (_crop_x > -1) && (_crop_y > -1);
   }
@@ -53,16 +104,89 @@ public:
   int getCropY() const {
     return _crop_y;
   }
+  int getCaptureScale() const {
+    return _capture_scale;
+  }
+  // Size of the screen image that covers the display at the capture scale.
+  int getCaptureWidth() const {
+    return (getDisplayWidth() + _capture_scale - 1) / _capture_scale;
+  }
+  int getCaptureHeight() const {
+    return (getDisplayHeight() + _capture_scale - 1) / _capture_scale;
+  }
+  // Time a screen capture may take before the last good frame is shown
+  // again, 0 to capture synchronously.
+  int getCaptureDeadline() const {
+    return _capture_deadline_ms;
+  }
+  bool hasWindows() const {
+    return !_windows.empty();
+  }
+  // Get the windows to compose onto the display.  When none are configured
+  // this is a single window covering the display, taken from the crop origin
+  // if one is set.
+  std::vector<Compositor::Window> getWindows() const;
+  int getFrameInterpolation() const {
+    return _frame_interpolation;
+  }
+  bool hasDither() const {
+    return _dither;
+  }
+  // Threads converting frames straight into the matrix framebuffer, 0 to
+  // draw them with SetPixel.
+  int getDirectOutputThreads() const {
+    return _direct_output_threads;
+  }
+  bool hasArtNetSource() const {
+    return _artnet.port > 0;
+  }
+  const ArtNetSource& getArtNetSource() const {
+    return _artnet;
+  }
+  bool hasShard() const {
+    return !_shard.host.empty();
+  }
+  const Shard& getShard() const {
+    return _shard;
+  }
+  bool hasTicker() const {
+    return !_ticker.text.empty();
+  }
+  const Ticker& getTicker() const {
+    return _ticker;
+  }
 
 private:
+  // Size of the panels as mounted, before any display transform.
+  int getPanelsWidth() const {
+    return (_display_width < 0)
+      ? getPanelWidth() * getChainLength()
+      : _display_width;
+  }
+  int getPanelsHeight() const {
+    return (_display_height < 0)
+      ? getPanelHeight() * getParallelCount()
+      : _display_height;
+  }
+
   rgb_matrix::RGBMatrix::Options* const _moptions;
   int _display_width,
       _display_height,
       _panel_width,
       _chain_length,
       _crop_x,
-      _crop_y;
+      _crop_y,
+      _capture_scale,
+      _capture_deadline_ms,
+      _frame_interpolation,
+      _direct_output_threads;
   std::vector<GridTransformer::Panel> _panels;
+  std::vector<Compositor::Window> _windows;
+  bool _dither;
+  DisplayTransform _transform;
+  ArtNetSource _artnet;
+  Shard _shard;
+  Ticker _ticker;
 };
 
 #endif
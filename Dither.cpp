@@ -0,0 +1,73 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Ordered and temporal dithering matched to the matrix PWM bit depth.
+#include <cmath>
+#include <stdexcept>
+
+#include "Dither.h"
+
+using namespace std;
+
+// Number of bit planes the matrix library maps colors to before dropping the
+// planes below the configured PWM bits.
+static const int kBitPlanes = 11;
+
+// 4x4 Bayer matrix, the order thresholds are used in within a block.
+static const int kBayer[4][4] = {
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+// Shifts of the pattern from frame to frame.  Over the 4 frames each pixel
+// goes through 4 thresholds a quarter of the range apart, and the pixel with
+// the lowest threshold moves around the 4x4 block.
+static const int kFrameOffsets[4] = { 0, 8, 4, 12 };
+
+// Luminance corrected level of a color value in the full bit plane range,
+// before truncating to an integer.  Same CIE1931 curve the library uses.
+static double luminance(int c, int brightness) {
+  double v = c * brightness / 255.0;
+  double out_factor = (1 << kBitPlanes) - 1;
+  return out_factor * ((v <= 8) ? v / 902.3 : pow((v + 16) / 116.0, 3));
+}
+
+Dither::Dither(int pwm_bits, int brightness):
+  _frame(0)
+{
+  if ((pwm_bits < 1) || (pwm_bits > kBitPlanes)) {
+    throw invalid_argument("PWM bits must be between 1 and 11!");
+  }
+  // Compute the level each value ends up at on the matrix, and the exact
+  // level it should have had without dropping the lower bit planes.
+  const double step = 1 << (kBitPlanes - pwm_bits);
+  int level[256];
+  double exact[256];
+  for (int c=0; c<256; ++c) {
+    level[c] = ((int)luminance(c, brightness)) >> (kBitPlanes - pwm_bits);
+    exact[c] = luminance(c, brightness) / step;
+  }
+  // Pair every value with the first value above it that reaches a higher
+  // level, and how far between the two levels it really is.
+  for (int c=0; c<256; ++c) {
+    _high[c] = c;
+    _fraction[c] = 0;
+    for (int h=c+1; h<256; ++h) {
+      if (level[h] > level[c]) {
+        double fraction = (exact[c] - level[c]) / (level[h] - level[c]);
+        _high[c] = h;
+        _fraction[c] = (uint8_t)min(255.0, max(0.0, fraction*256.0));
+        break;
+      }
+    }
+  }
+  // Build the shifted threshold pattern for each frame, with thresholds
+  // spread evenly over the 0-255 range of the fractions.
+  for (int f=0; f<4; ++f) {
+    for (int y=0; y<4; ++y) {
+      for (int x=0; x<4; ++x) {
+        _thresholds[f][y][x] = ((kBayer[y][x] + kFrameOffsets[f]) & 0x0F)*16 + 8;
+      }
+    }
+  }
+}
@@ -0,0 +1,43 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Ordered and temporal dithering matched to the matrix PWM bit depth.
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <cstdint>
+
+// With fewer PWM bits the matrix library can only show a few of the 256
+// levels of each color, which shows up as banding in gradients.  Dither picks
+// between the two closest levels the matrix can show for every pixel, using a
+// 4x4 ordered threshold pattern that is shifted every frame, so both across
+// neighboring pixels and over successive frames the average comes out at the
+// original 8 bit level.  The pattern only goes through 4 shifts: a pixel that
+// is lit once per cycle then repeats every 4 frames, which does not read as
+// blinking even at the 40Hz the screen is copied at.
+class Dither {
+public:
+  // Model the library's luminance corrected color mapping for the given
+  // PWM bits and brightness (in percent) to find the levels it can show.
+  Dither(int pwm_bits, int brightness = 100);
+
+  // Move the threshold pattern on for the next frame.
+  void nextFrame() {
+    _frame = (_frame + 1) & 0x03;
+  }
+
+  void apply(int x, int y, uint8_t* r, uint8_t* g, uint8_t* b) const {
+    const uint8_t threshold = _thresholds[_frame][y & 0x03][x & 0x03];
+    *r = (_fraction[*r] > threshold) ? _high[*r] : *r;
+    *g = (_fraction[*g] > threshold) ? _high[*g] : *g;
+    *b = (_fraction[*b] > threshold) ? _high[*b] : *b;
+  }
+
+private:
+  int _frame;
+  // For every 8 bit value, the next value up that the matrix shows at a
+  // higher level and how far towards that level the value is (0-255).
+  uint8_t _high[256],
+          _fraction[256];
+  uint8_t _thresholds[4][4][4];
+};
+
+#endif
@@ -0,0 +1,119 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Presents blended in-between frames to drive the display faster than the
+// screen can be captured.
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "FrameInterpolator.h"
+#include "LatencyStats.h"
+
+using namespace std;
+
+FrameInterpolator::FrameInterpolator(int width, int height, int factor,
+                                     const function<void(const FrameSource&)>& present):
+  _factor(factor),
+  _present(present),
+  _input(width, height),
+  _incoming(new Frame(width, height)),
+  _previous(new Frame(width, height)),
+  _current(new Frame(width, height)),
+  _blended(new Frame(width, height)),
+  _pending(false),
+  _stopping(false),
+  _pushed_at(0),
+  _static_count(0)
+{
+  if (_factor < 1) {
+    throw invalid_argument("Frame interpolation factor must be 1 or more!");
+  }
+  _thread = thread(&FrameInterpolator::run, this);
+}
+
+FrameInterpolator::~FrameInterpolator() {
+  {
+    lock_guard<mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _condition.notify_all();
+  _thread.join();
+}
+
+void FrameInterpolator::push() {
+  {
+    lock_guard<mutex> lock(_mutex);
+    // The input canvas and frames are both tightly packed, copy it as a whole.
+    memcpy(_incoming->getData(), _input.getRow(0),
+           _incoming->pitch()*_incoming->height());
+    _pending = true;
+    _pushed_at = LatencyStats::now();
+  }
+  _condition.notify_all();
+}
+
+void FrameInterpolator::blend(int step) {
+  // Linear blend step/factor of the way from the previous to the current frame.
+  const size_t size = _current->pitch()*_current->height();
+  const uint8_t* from = _previous->getRow(0);
+  const uint8_t* to = _current->getRow(0);
+  uint8_t* out = _blended->getData();
+  for (size_t i=0; i<size; ++i) {
+    out[i] = (from[i]*(_factor - step) + to[i]*step) / _factor;
+  }
+}
+
+void FrameInterpolator::run() {
+  uint64_t last_pushed_at = 0;
+  uint64_t interval = 0;
+  bool have_previous = false;
+  while (true) {
+    // Wait for the next captured frame and take it over.
+    uint64_t pushed_at;
+    {
+      unique_lock<mutex> lock(_mutex);
+      _condition.wait(lock, [this] { return _pending || _stopping; });
+      if (_stopping) {
+        return;
+      }
+      swap(_previous, _current);
+      swap(_current, _incoming);
+      _pending = false;
+      pushed_at = _pushed_at;
+    }
+    if (last_pushed_at > 0) {
+      // Smooth the measured capture interval so one slow capture does not
+      // throw off the pacing.
+      uint64_t measured = pushed_at - last_pushed_at;
+      interval = (interval == 0) ? measured : (interval*7 + measured) / 8;
+    }
+    last_pushed_at = pushed_at;
+
+    // Show static content (or the very first frame) just once.
+    const size_t size = _current->pitch()*_current->height();
+    if (!have_previous || (interval == 0) ||
+        (memcmp(_previous->getRow(0), _current->getRow(0), size) == 0)) {
+      have_previous = true;
+      ++_static_count;
+      _present(*_current);
+      continue;
+    }
+
+    // Spread the in-between frames evenly over the capture interval, ending
+    // on the captured frame itself.
+    for (int step=1; step<=_factor; ++step) {
+      if (step < _factor) {
+        blend(step);
+        _present(*_blended);
+      }
+      else {
+        _present(*_current);
+      }
+      uint64_t due = pushed_at + interval*step/_factor;
+      uint64_t now = LatencyStats::now();
+      if ((step < _factor) && (now < due)) {
+        usleep(due - now);
+      }
+    }
+  }
+}
@@ -0,0 +1,76 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Presents blended in-between frames to drive the display faster than the
+// screen can be captured.
+#ifndef FRAMEINTERPOLATOR_H
+#define FRAMEINTERPOLATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "FrameSource.h"
+#include "MemoryCanvas.h"
+
+// Captured frames are drawn on the input canvas and pushed.  A presentation
+// thread then shows factor frames for every captured one, linearly blending
+// from the previous capture to the latest over the measured capture
+// interval.  This delays the display by one capture.  When two captures in a
+// row are identical the blending is skipped and the frame is shown once.
+class FrameInterpolator {
+public:
+  FrameInterpolator(int width, int height, int factor,
+                    const std::function<void(const FrameSource&)>& present);
+  ~FrameInterpolator();
+
+  // Canvas to draw the next captured frame on before calling push.
+  MemoryCanvas* getInput() {
+    return &_input;
+  }
+  // Hand the frame on the input canvas to the presentation thread.
+  void push();
+
+  // Number of captured frames that were shown without blending because
+  // nothing changed.
+  int getStaticCount() const {
+    return _static_count;
+  }
+
+private:
+  // Frame buffer the presentation thread reads from and blends into.
+  class Frame: public FrameSource {
+  public:
+    Frame(int width, int height) {
+      allocate(width, height, width*3);
+    }
+    virtual bool capture() {
+      return true;
+    }
+    uint8_t* getData() {
+      return _data;
+    }
+  };
+
+  void run();
+  void blend(int step);
+
+  const int _factor;
+  std::function<void(const FrameSource&)> _present;
+  MemoryCanvas _input;
+  std::unique_ptr<Frame> _incoming,
+                         _previous,
+                         _current,
+                         _blended;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _pending,
+       _stopping;
+  uint64_t _pushed_at;
+  std::atomic<int> _static_count;
+  std::thread _thread;
+};
+
+#endif
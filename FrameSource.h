@@ -0,0 +1,87 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Base class for anything that produces frames to copy to the LED display,
+// like the Pi's primary display or a synthetic test pattern.
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class FrameSource {
+public:
+  FrameSource():
+    _width(0),
+    _height(0),
+    _pitch(0),
+    _data(NULL)
+  {}
+  virtual ~FrameSource() {
+    if (_data != NULL) {
+      delete[] _data;
+    }
+  }
+
+  // Grab a new frame.  Returns false if no new frame could be captured, in
+  // which case the data of the last good frame is kept.
+  virtual bool capture() = 0;
+
+  // Attribute accessors:
+  int width() const {
+    return _width;
+  }
+  int height() const {
+    return _height;
+  }
+  int pitch() const {
+    return _pitch;
+  }
+
+  // Frame data is stored as packed 24-bit RGB rows, pitch bytes apart.
+  const uint8_t* getRow(int y) const {
+    return _data + (y*_pitch);
+  }
+  void getPixel(int x, int y, uint8_t* r, uint8_t* g, uint8_t* b) const {
+    const uint8_t* row = getRow(y);
+    *r = row[x*3];
+    *g = row[x*3+1];
+    *b = row[x*3+2];
+  }
+
+protected:
+  // Allocate the frame buffer.  Subclasses call this once they know the size
+  // of the frames they will produce.
+  void allocate(int width, int height, int pitch) {
+    if (_data != NULL) {
+      delete[] _data;
+    }
+    _width = width;
+    _height = height;
+    _pitch = pitch;
+    _data = new uint8_t[_pitch*_height]();
+  }
+
+  // Exchange frame buffers with another source of the same size and pitch,
+  // so a frame can be handed over without copying it.  Returns false if the
+  // sizes differ.
+  bool swapData(FrameSource& other) {
+    if ((other._width != _width) || (other._height != _height) ||
+        (other._pitch != _pitch)) {
+      return false;
+    }
+    uint8_t* data = other._data;
+    other._data = _data;
+    _data = data;
+    return true;
+  }
+
+  int _width,
+      _height,
+      _pitch;
+  uint8_t* _data;
+
+private:
+  FrameSource(const FrameSource&) = delete;
+  FrameSource& operator=(const FrameSource&) = delete;
+};
+
+#endif
@@ -0,0 +1,69 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Pre-rasterized copy of the glcdfont 5x8 font at an integer scale.
+#include <stdexcept>
+
+#include "glcdfont.h"
+#include "GlyphAtlas.h"
+#include "GridTransformer.h"
+
+using namespace rgb_matrix;
+using namespace std;
+
+GlyphAtlas::GlyphAtlas(int scale):
+  _scale(scale)
+{
+  if ((_scale < 1) || (_scale > kMaxScale)) {
+    throw invalid_argument("Text scale must be between 1 and 8!");
+  }
+  // Rasterize all 256 characters, stretching every font bit into a
+  // scale x scale block.  The last column of each character stays empty as
+  // padding between characters.
+  _columns.resize(256*getAdvance(), 0);
+  for (int c=0; c<256; ++c) {
+    for (int i=0; i<5; ++i) {
+      uint8_t font_column = glcdfont[c*5+i];
+      uint64_t column = 0;
+      for (int j=0; j<8; ++j) {
+        if ((font_column >> j) & 0x01) {
+          column |= ((((uint64_t)1) << _scale) - 1) << (j*_scale);
+        }
+      }
+      for (int k=0; k<_scale; ++k) {
+        _columns[c*getAdvance() + i*_scale + k] = column;
+      }
+    }
+  }
+}
+
+int GlyphAtlas::draw(Canvas* canvas, int x, int y, const string& text,
+                     uint8_t r, uint8_t g, uint8_t b) const {
+  int count = 0;
+  for (auto c: text) {
+    for (int i=0; i<getAdvance(); ++i, ++x) {
+      uint64_t column = getColumn(c, i);
+      if (column != 0) {
+        count += drawColumn(canvas, x, y, column, getHeight(), r, g, b);
+      }
+    }
+  }
+  return count;
+}
+
+int GlyphAtlas::drawColumn(Canvas* canvas, int x, int y, uint64_t column,
+                           int height, uint8_t r, uint8_t g, uint8_t b) {
+  GridTransformer* grid = dynamic_cast<GridTransformer*>(canvas);
+  if (grid != NULL) {
+    return grid->drawColumn(x, y, column, height, r, g, b);
+  }
+  if ((x < 0) || (x >= canvas->width())) {
+    return 0;
+  }
+  int count = 0;
+  for (int j=0; j<height; ++j) {
+    if ((column >> j) & 0x01) {
+      canvas->SetPixel(x, y+j, r, g, b);
+      ++count;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,60 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Pre-rasterized copy of the glcdfont 5x8 font at an integer scale.
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "led-matrix.h"
+
+// Every glyph is stored as a list of columns, each column a bit mask with bit
+// n set when row n of the column is lit.  Drawing text then means blitting
+// whole columns instead of testing every font bit of every character.
+class GlyphAtlas {
+public:
+  // Largest scale whose columns still fit in a 64 bit mask.
+  static const int kMaxScale = 8;
+
+  GlyphAtlas(int scale = 1);
+
+  // Attribute accessors:
+  int getScale() const {
+    return _scale;
+  }
+  int getHeight() const {
+    return 8*_scale;
+  }
+  // Width of a character including the column of padding after it.
+  int getAdvance() const {
+    return 6*_scale;
+  }
+  int getTextWidth(const std::string& text) const {
+    return text.size()*getAdvance();
+  }
+
+  // Get column x (0 to getAdvance()-1) of a character.
+  uint64_t getColumn(unsigned char c, int x) const {
+    return _columns[c*getAdvance() + x];
+  }
+
+  // Draw text with its top left corner at x, y.  Returns the number of
+  // pixels that were set.
+  int draw(rgb_matrix::Canvas* canvas, int x, int y, const std::string& text,
+           uint8_t r = 255, uint8_t g = 255, uint8_t b = 255) const;
+
+  // Set the lit pixels of a column mask, with bit 0 at x, y.  Columns are
+  // handed to GridTransformer::drawColumn when drawing on one so each panel
+  // mapping is only looked up once per column.  Returns the number of pixels
+  // that were set.
+  static int drawColumn(rgb_matrix::Canvas* canvas, int x, int y,
+                        uint64_t column, int height,
+                        uint8_t r, uint8_t g, uint8_t b);
+
+private:
+  int _scale;
+  std::vector<uint64_t> _columns;
+};
+
+#endif
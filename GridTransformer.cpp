@@ -1,6 +1,8 @@
 // LED matrix library transformer to map a rectangular canvas onto a complex
 // chain of matrices.
 // Author: Tony DiCola
+#include <algorithm>
+
 #include "GridTransformer.h"
 
 using namespace rgb_matrix;
@@ -29,8 +31,15 @@ GridTransformer::GridTransformer(int width, int height, int panel_width, int pan
 
 void GridTransformer::SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue) {
   assert(_source != NULL);
+  int matrix_x, matrix_y;
+  if (mapPixel(x, y, &matrix_x, &matrix_y)) {
+    _source->SetPixel(matrix_x, matrix_y, red, green, blue);
+  }
+}
+
+bool GridTransformer::mapPixel(int x, int y, int* matrix_x, int* matrix_y) const {
   if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height)) {
-    return;
+    return false;
   }
 
   // Figure out what row and column panel this pixel is within.
@@ -38,7 +47,7 @@ void GridTransformer::SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t
   int col = x / _panel_width;
 
   // Get the panel information for this pixel.
-  Panel panel = _panels[_cols*row + col];
+  const Panel& panel = _panels[_cols*row + col];
 
   // Compute location of the pixel within the panel.
   x = x % _panel_width;
@@ -72,16 +81,113 @@ void GridTransformer::SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t
   // Determine y offset into the source panel based on its parrallel chain value.
   int y_offset = panel.parallel*_panel_height;
 
-  _source->SetPixel(x_offset + x,
-                    y_offset + y,
-                    red, green, blue);
+  *matrix_x = x_offset + x;
+  *matrix_y = y_offset + y;
+  return true;
+}
+
+int GridTransformer::drawColumn(int x, int y, uint64_t column, int height,
+                                uint8_t red, uint8_t green, uint8_t blue) {
+  assert(_source != NULL);
+  if ((x < 0) || (x >= _width)) {
+    return 0;
+  }
+  // Clip the column to the top and bottom of the display.
+  if (y < 0) {
+    column = (-y < 64) ? (column >> -y) : 0;
+    height += y;
+    y = 0;
+  }
+  if (y + height > _height) {
+    height = _height - y;
+  }
+
+  int count = 0;
+  while ((height > 0) && (column != 0)) {
+    // Map only the first pixel of the part of the column inside this panel,
+    // the rest of it is a straight line on the matrix canvas whose direction
+    // depends on the panel rotation.
+    int run = std::min(height, _panel_height - (y % _panel_height));
+    const Panel& panel = _panels[_cols*(y / _panel_height) + (x / _panel_width)];
+    int dx = 0;
+    int dy = 1;
+    if (panel.rotate == 90) {
+      dx = -1;
+      dy = 0;
+    }
+    else if (panel.rotate == 180) {
+      dy = -1;
+    }
+    else if (panel.rotate == 270) {
+      dx = 1;
+      dy = 0;
+    }
+    int matrix_x, matrix_y;
+    mapPixel(x, y, &matrix_x, &matrix_y);
+    for (int j=0; j<run; ++j) {
+      if ((column >> j) & 0x01) {
+        _source->SetPixel(matrix_x + j*dx, matrix_y + j*dy, red, green, blue);
+        ++count;
+      }
+    }
+    column = (run < 64) ? (column >> run) : 0;
+    y += run;
+    height -= run;
+  }
+  return count;
+}
+
+void GridTransformer::drawRow(int x, int y, const uint8_t* pixels, int count) {
+  assert(_source != NULL);
+  if ((y < 0) || (y >= _height)) {
+    return;
+  }
+  // Clip the row to the left and right of the display.
+  if (x < 0) {
+    pixels += -x*3;
+    count += x;
+    x = 0;
+  }
+  if (x + count > _width) {
+    count = _width - x;
+  }
+
+  while (count > 0) {
+    // Like drawColumn, map only the first pixel of the part of the row inside
+    // this panel and step along the matrix canvas for the rest.
+    int run = std::min(count, _panel_width - (x % _panel_width));
+    const Panel& panel = _panels[_cols*(y / _panel_height) + (x / _panel_width)];
+    int dx = 1;
+    int dy = 0;
+    if (panel.rotate == 90) {
+      dx = 0;
+      dy = 1;
+    }
+    else if (panel.rotate == 180) {
+      dx = -1;
+    }
+    else if (panel.rotate == 270) {
+      dx = 0;
+      dy = -1;
+    }
+    int matrix_x, matrix_y;
+    mapPixel(x, y, &matrix_x, &matrix_y);
+    for (int i=0; i<run; ++i, pixels+=3) {
+      _source->SetPixel(matrix_x + i*dx, matrix_y + i*dy,
+                        pixels[0], pixels[1], pixels[2]);
+    }
+    x += run;
+    count -= run;
+  }
 }
 
 Canvas* GridTransformer::Transform(Canvas* source) {
   assert(source != NULL);
   int swidth = source->width();
   int sheight = source->height();
-  assert((_width * _height) == (swidth * sheight));
+  // Chains may be left short when the panels do not divide evenly between
+  // the parallel outputs, so the matrix can have unused space at their ends.
+  assert((_width * _height) <= (swidth * sheight));
   _source = source;
   return this;
 }
@@ -5,6 +5,7 @@
 #define GRIDTRANSFORMER_H
 
 #include <cassert>
+#include <cstdint>
 #include <vector>
 
 #include "led-matrix.h"
@@ -50,6 +51,21 @@ public:
     return _cols;
   }
 
+  // Set the pixels of a column starting at x, y for each bit set in the
+  // column mask (bit 0 is the top pixel).  Faster than calling SetPixel for
+  // each of them as the panel mapping is only computed once per panel the
+  // column crosses.  Returns the number of pixels that were set.
+  int drawColumn(int x, int y, uint64_t column, int height,
+                 uint8_t red, uint8_t green, uint8_t blue);
+
+  // Set a row of count pixels starting at x, y from packed 24-bit RGB data,
+  // mapping each panel the row crosses only once like drawColumn.
+  void drawRow(int x, int y, const uint8_t* pixels, int count);
+
+  // Compute where a display pixel lands on the underlying matrix canvas.
+  // Returns false if the pixel is outside the display.
+  bool mapPixel(int x, int y, int* matrix_x, int* matrix_y) const;
+
 private:
   int _width,
       _height,
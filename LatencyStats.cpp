@@ -0,0 +1,78 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Collects timing samples and reports their distribution.
+#include <algorithm>
+#include <iomanip>
+
+#include <time.h>
+
+#include "LatencyStats.h"
+
+using namespace std;
+
+LatencyStats::LatencyStats(const string& name):
+  _name(name),
+  _dirty(false)
+{}
+
+void LatencyStats::add(double usec) {
+  _samples.push_back(usec);
+  _dirty = true;
+}
+
+void LatencyStats::clear() {
+  _samples.clear();
+  _sorted.clear();
+  _dirty = false;
+}
+
+double LatencyStats::min() const {
+  return percentile(0.0);
+}
+
+double LatencyStats::max() const {
+  return percentile(1.0);
+}
+
+double LatencyStats::mean() const {
+  if (_samples.empty()) {
+    return 0.0;
+  }
+  double sum = 0.0;
+  for (auto sample: _samples) {
+    sum += sample;
+  }
+  return sum / _samples.size();
+}
+
+double LatencyStats::percentile(double fraction) const {
+  if (_samples.empty()) {
+    return 0.0;
+  }
+  // Sort a copy of the samples only when new ones arrived since the last query.
+  if (_dirty || (_sorted.size() != _samples.size())) {
+    _sorted = _samples;
+    sort(_sorted.begin(), _sorted.end());
+    _dirty = false;
+  }
+  fraction = std::min(1.0, std::max(0.0, fraction));
+  return _sorted[(size_t)(fraction*(_sorted.size()-1) + 0.5)];
+}
+
+void LatencyStats::print(ostream& out) const {
+  out << " " << setw(12) << left << _name << right
+      << fixed << setprecision(2)
+      << " n=" << setw(6) << count()
+      << " min=" << setw(8) << min()/1000.0
+      << " p50=" << setw(8) << percentile(0.5)/1000.0
+      << " p95=" << setw(8) << percentile(0.95)/1000.0
+      << " p99=" << setw(8) << percentile(0.99)/1000.0
+      << " max=" << setw(8) << max()/1000.0
+      << " mean=" << setw(8) << mean()/1000.0
+      << " ms" << endl;
+}
+
+uint64_t LatencyStats::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
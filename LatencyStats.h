@@ -0,0 +1,42 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Collects timing samples and reports their distribution.
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class LatencyStats {
+public:
+  LatencyStats(const std::string& name);
+
+  // Add a sample, in microseconds.
+  void add(double usec);
+  void clear();
+
+  size_t count() const {
+    return _samples.size();
+  }
+  double min() const;
+  double max() const;
+  double mean() const;
+  // Get the sample below which the given fraction (0-1) of samples fall.
+  double percentile(double fraction) const;
+
+  // Print a one line summary of the distribution in milliseconds.
+  void print(std::ostream& out) const;
+
+  // Current time of the monotonic clock in microseconds.
+  static uint64_t now();
+
+private:
+  std::string _name;
+  std::vector<double> _samples;
+  mutable std::vector<double> _sorted;
+  mutable bool _dirty;
+};
+
+#endif
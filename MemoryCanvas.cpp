@@ -0,0 +1,64 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Canvas that keeps a copy of its pixels in memory.
+#include <cstring>
+
+#include "MemoryCanvas.h"
+
+MemoryCanvas::MemoryCanvas(int width, int height, rgb_matrix::Canvas* delegate):
+  _width(width),
+  _height(height),
+  _pixels(width*height*3, 0),
+  _delegate(delegate)
+{}
+
+void MemoryCanvas::Clear() {
+  Fill(0, 0, 0);
+}
+
+void MemoryCanvas::Fill(uint8_t red, uint8_t green, uint8_t blue) {
+  for (size_t i=0; i<_pixels.size(); i+=3) {
+    _pixels[i] = red;
+    _pixels[i+1] = green;
+    _pixels[i+2] = blue;
+  }
+  if (_delegate != NULL) {
+    _delegate->Fill(red, green, blue);
+  }
+}
+
+void MemoryCanvas::SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue) {
+  if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height)) {
+    return;
+  }
+  uint8_t* pixel = &_pixels[(y*_width + x)*3];
+  pixel[0] = red;
+  pixel[1] = green;
+  pixel[2] = blue;
+  if (_delegate != NULL) {
+    _delegate->SetPixel(x, y, red, green, blue);
+  }
+}
+
+void MemoryCanvas::drawRow(int x, int y, const uint8_t* pixels, int count) {
+  if ((y < 0) || (y >= _height)) {
+    return;
+  }
+  // Clip the row to the left and right of the canvas.
+  if (x < 0) {
+    pixels += -x*3;
+    count += x;
+    x = 0;
+  }
+  if (x + count > _width) {
+    count = _width - x;
+  }
+  if (count <= 0) {
+    return;
+  }
+  memcpy(&_pixels[(y*_width + x)*3], pixels, count*3);
+  if (_delegate != NULL) {
+    for (int i=0; i<count; ++i, pixels+=3) {
+      _delegate->SetPixel(x + i, y, pixels[0], pixels[1], pixels[2]);
+    }
+  }
+}
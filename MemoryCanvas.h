@@ -0,0 +1,59 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Canvas that keeps a copy of its pixels in memory.  Used to emulate the LED
+// matrices when no hardware is attached, or to mirror what is sent to them.
+#ifndef MEMORYCANVAS_H
+#define MEMORYCANVAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "led-matrix.h"
+
+class MemoryCanvas: public rgb_matrix::Canvas {
+public:
+  // If a delegate canvas is given every pixel is also forwarded to it.
+  MemoryCanvas(int width, int height, rgb_matrix::Canvas* delegate = NULL);
+  virtual ~MemoryCanvas() {}
+
+  // Canvas interface implementation:
+  virtual int width() const {
+    return _width;
+  }
+  virtual int height() const {
+    return _height;
+  }
+  virtual void Clear();
+  virtual void Fill(uint8_t red, uint8_t green, uint8_t blue);
+  virtual void SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue);
+
+  // Set a row of count pixels starting at x, y from packed 24-bit RGB data,
+  // copying it whole instead of going through SetPixel for every pixel.
+  void drawRow(int x, int y, const uint8_t* pixels, int count);
+
+  // Pixels are stored as packed 24-bit RGB rows, width*3 bytes apart.
+  const uint8_t* getRow(int y) const {
+    return &_pixels[y*_width*3];
+  }
+  void getPixel(int x, int y, uint8_t* r, uint8_t* g, uint8_t* b) const {
+    const uint8_t* pixel = getRow(y) + x*3;
+    *r = pixel[0];
+    *g = pixel[1];
+    *b = pixel[2];
+  }
+
+  rgb_matrix::Canvas* getDelegate() const {
+    return _delegate;
+  }
+  void setDelegate(rgb_matrix::Canvas* delegate) {
+    _delegate = delegate;
+  }
+
+private:
+  int _width,
+      _height;
+  std::vector<uint8_t> _pixels;
+  rgb_matrix::Canvas* _delegate;
+};
+
+#endif
@@ -0,0 +1,32 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Machine readable frame sequence code used to measure display latency.
+#include "ProbeCode.h"
+
+// Check value that also guarantees a code is never all on or all off.
+static uint8_t checkValue(uint16_t sequence) {
+  return ((sequence >> 8) ^ (sequence & 0xFF)) ^ 0xA5;
+}
+
+void ProbeCode::encode(uint16_t sequence,
+                       const std::function<void(int, int, bool)>& set_cell) {
+  uint32_t bits = ((uint32_t)sequence << 8) | checkValue(sequence);
+  for (int i=0; i<kColumns*kRows; ++i) {
+    set_cell(i % kColumns, i / kColumns, (bits >> i) & 0x01);
+  }
+}
+
+bool ProbeCode::decode(const std::function<bool(int, int)>& get_cell,
+                       uint16_t* sequence) {
+  uint32_t bits = 0;
+  for (int i=0; i<kColumns*kRows; ++i) {
+    if (get_cell(i % kColumns, i / kColumns)) {
+      bits |= (1 << i);
+    }
+  }
+  uint16_t decoded = bits >> 8;
+  if ((bits & 0xFF) != checkValue(decoded)) {
+    return false;
+  }
+  *sequence = decoded;
+  return true;
+}
@@ -0,0 +1,33 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Machine readable frame sequence code used to measure display latency.
+#ifndef PROBECODE_H
+#define PROBECODE_H
+
+#include <cstdint>
+#include <functional>
+
+// The code is a small grid of on/off cells holding a 16 bit sequence number
+// and an 8 bit check value.  Callers decide how big a cell is and where the
+// grid lives, the code only deals in cell columns and rows.
+class ProbeCode {
+public:
+  static const int kColumns = 8;
+  static const int kRows = 3;
+
+  // Call set_cell(column, row, on) for every cell of the code.
+  static void encode(uint16_t sequence,
+                     const std::function<void(int, int, bool)>& set_cell);
+
+  // Read every cell with get_cell(column, row) and recover the sequence
+  // number.  Returns false if the check value does not match, for example
+  // when no code is present or the frame was torn.
+  static bool decode(const std::function<bool(int, int)>& get_cell,
+                     uint16_t* sequence);
+
+  // Decide if an RGB sample of a cell is on (bright) or off (dark).
+  static bool isOn(uint8_t r, uint8_t g, uint8_t b) {
+    return (r + g + b) > 3*128;
+  }
+};
+
+#endif
@@ -0,0 +1,49 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Packets that keep the nodes of a sharded display presenting in step.
+#include <cstring>
+
+#include "ShardProtocol.h"
+
+// Out-of-class definition, for when the size is bound to a reference.
+const size_t ShardProtocol::kPacketSize;
+
+static const char kId[8] = { 'F', 'b', 'S', 'h', 'a', 'r', 'd', 0 };
+
+// Multi-byte values are little endian, like the Art-Net opcodes.
+static void writeValue(uint8_t* buffer, uint64_t value, int bytes) {
+  for (int i=0; i<bytes; ++i) {
+    buffer[i] = (value >> (8*i)) & 0xFF;
+  }
+}
+
+static uint64_t readValue(const uint8_t* buffer, int bytes) {
+  uint64_t value = 0;
+  for (int i=0; i<bytes; ++i) {
+    value |= (uint64_t)buffer[i] << (8*i);
+  }
+  return value;
+}
+
+size_t ShardProtocol::build(uint8_t* buffer, const Packet& packet) {
+  memcpy(buffer, kId, sizeof(kId));
+  writeValue(buffer + 8, packet.type, 2);
+  writeValue(buffer + 10, packet.frame, 4);
+  writeValue(buffer + 14, packet.sent_time, 8);
+  writeValue(buffer + 22, packet.present_time, 8);
+  return kPacketSize;
+}
+
+bool ShardProtocol::parse(const uint8_t* buffer, size_t size, Packet* packet) {
+  if ((size < kPacketSize) || (memcmp(buffer, kId, sizeof(kId)) != 0)) {
+    return false;
+  }
+  uint16_t type = readValue(buffer + 8, 2);
+  if ((type != kPresent) && (type != kAck)) {
+    return false;
+  }
+  packet->type = (PacketType)type;
+  packet->frame = readValue(buffer + 10, 4);
+  packet->sent_time = readValue(buffer + 14, 8);
+  packet->present_time = readValue(buffer + 22, 8);
+  return true;
+}
@@ -0,0 +1,43 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Packets that keep the nodes of a sharded display presenting in step.
+#ifndef SHARDPROTOCOL_H
+#define SHARDPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// A coordinator streams each node its tile of the frame with Art-Net, then
+// sends a present packet in place of ArtSync.  It carries the frame number,
+// the coordinator's clock when it was sent and the time on that clock the
+// frame should be shown.  Nodes answer with an ack carrying the frame number
+// and the time they showed it, converted back to the coordinator's clock.
+// Packets are sent on the same socket as the Art-Net data so a present
+// packet always arrives after the tile it completes.
+class ShardProtocol {
+public:
+  static const size_t kPacketSize = 30;
+
+  enum PacketType {
+    kInvalid,
+    kPresent,
+    kAck
+  };
+
+  struct Packet {
+    PacketType type;
+    uint32_t frame;
+    // Present: when it was sent and when to show the frame.  Ack: when it
+    // was sent and when the frame was shown.  Times are microseconds on the
+    // coordinator's monotonic clock.
+    uint64_t sent_time,
+             present_time;
+  };
+
+  // Fill buffer (at least kPacketSize bytes) with the packet and return its
+  // size.
+  static size_t build(uint8_t* buffer, const Packet& packet);
+  // Decode a received packet, returning false if it is not one of ours.
+  static bool parse(const uint8_t* buffer, size_t size, Packet* packet);
+};
+
+#endif
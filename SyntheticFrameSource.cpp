@@ -0,0 +1,49 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that renders a moving test pattern.
+#include "ProbeCode.h"
+#include "SyntheticFrameSource.h"
+
+SyntheticFrameSource::SyntheticFrameSource(int width, int height):
+  _frame(0),
+  _probe_cell(0),
+  _probe_x(0),
+  _probe_y(0),
+  _probe_sequence(0)
+{
+  allocate(width, height, width*3);
+}
+
+void SyntheticFrameSource::setProbeCode(uint16_t sequence, int cell_size,
+                                        int x, int y) {
+  _probe_sequence = sequence;
+  _probe_cell = cell_size;
+  _probe_x = x;
+  _probe_y = y;
+}
+
+bool SyntheticFrameSource::capture() {
+  // Draw a diagonal gradient that scrolls one pixel to the right each frame.
+  for (int y=0; y<_height; ++y) {
+    uint8_t* row = _data + y*_pitch;
+    for (int x=0; x<_width; ++x) {
+      row[x*3] = (x - _frame)*4;
+      row[x*3+1] = y*4;
+      row[x*3+2] = (x + y + _frame)*2;
+    }
+  }
+  if (_probe_cell > 0) {
+    ProbeCode::encode(_probe_sequence, [this](int col, int row, bool on) {
+      uint8_t value = on ? 255 : 0;
+      const int top = _probe_y + row*_probe_cell;
+      const int left = _probe_x + col*_probe_cell;
+      for (int y=top; (y<top+_probe_cell) && (y<_height); ++y) {
+        for (int x=left; (x<left+_probe_cell) && (x<_width); ++x) {
+          uint8_t* pixel = _data + y*_pitch + x*3;
+          pixel[0] = pixel[1] = pixel[2] = value;
+        }
+      }
+    });
+  }
+  ++_frame;
+  return true;
+}
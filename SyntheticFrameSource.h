@@ -0,0 +1,33 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Frame source that renders a moving test pattern, for running the display
+// pipeline without a Pi display.
+#ifndef SYNTHETICFRAMESOURCE_H
+#define SYNTHETICFRAMESOURCE_H
+
+#include "FrameSource.h"
+
+class SyntheticFrameSource: public FrameSource {
+public:
+  SyntheticFrameSource(int width, int height);
+  virtual ~SyntheticFrameSource() {}
+
+  // Render the next frame of the pattern.
+  virtual bool capture();
+
+  // Stamp a ProbeCode with the given sequence number at x, y of every
+  // following frame, with cells of cell_size pixels.
+  void setProbeCode(uint16_t sequence, int cell_size, int x = 0, int y = 0);
+
+  int getFrameCount() const {
+    return _frame;
+  }
+
+private:
+  int _frame,
+      _probe_cell,
+      _probe_x,
+      _probe_y;
+  uint16_t _probe_sequence;
+};
+
+#endif
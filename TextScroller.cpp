@@ -0,0 +1,51 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Ticker that scrolls a message across the display.
+#include "TextScroller.h"
+
+using namespace rgb_matrix;
+using namespace std;
+
+TextScroller::TextScroller(const GlyphAtlas& atlas, const string& message,
+                           int y, int speed, uint8_t r, uint8_t g, uint8_t b):
+  _atlas(atlas),
+  _y(y),
+  _speed(speed),
+  _offset(0),
+  _r(r),
+  _g(g),
+  _b(b)
+{
+  setMessage(message);
+}
+
+void TextScroller::setMessage(const string& message) {
+  // Look up the columns of every character once so drawing a frame is just a
+  // walk along the strip.  A trailing space separates the end of the message
+  // from its start as it wraps around.
+  string text = message + " ";
+  _strip.clear();
+  _strip.reserve(_atlas.getTextWidth(text));
+  for (auto c: text) {
+    for (int i=0; i<_atlas.getAdvance(); ++i) {
+      _strip.push_back(_atlas.getColumn(c, i));
+    }
+  }
+  _offset = 0;
+}
+
+int TextScroller::draw(Canvas* canvas) {
+  const int length = _strip.size();
+  int count = 0;
+  for (int x=0; x<canvas->width(); ++x) {
+    uint64_t column = _strip[(x + _offset) % length];
+    if (column != 0) {
+      count += GlyphAtlas::drawColumn(canvas, x, _y, column,
+                                      _atlas.getHeight(), _r, _g, _b);
+    }
+  }
+  _offset = (_offset + _speed) % length;
+  if (_offset < 0) {
+    _offset += length;
+  }
+  return count;
+}
@@ -0,0 +1,42 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Ticker that scrolls a message across the display.
+#ifndef TEXTSCROLLER_H
+#define TEXTSCROLLER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GlyphAtlas.h"
+#include "led-matrix.h"
+
+class TextScroller {
+public:
+  TextScroller(const GlyphAtlas& atlas, const std::string& message, int y,
+               int speed = 1, uint8_t r = 255, uint8_t g = 255, uint8_t b = 255);
+
+  void setMessage(const std::string& message);
+  void setColor(uint8_t r, uint8_t g, uint8_t b) {
+    _r = r;
+    _g = g;
+    _b = b;
+  }
+
+  // Draw the ticker across the full width of the canvas, then move it speed
+  // pixels to the left for the next frame.  Returns the number of pixels set.
+  int draw(rgb_matrix::Canvas* canvas);
+
+private:
+  const GlyphAtlas& _atlas;
+  int _y,
+      _speed,
+      _offset;
+  uint8_t _r,
+          _g,
+          _b;
+  // All the columns of the message laid end to end, the ticker wraps around
+  // to the start when it reaches the end.
+  std::vector<uint64_t> _strip;
+};
+
+#endif
@@ -0,0 +1,151 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Program to stream a test pattern to rpi-fb-matrix over Art-Net, for testing
+// the network frame source (for example over loopback on the same Pi).
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <arpa/inet.h>
+#include <led-matrix.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ArtNet.h"
+#include "Config.h"
+#include "LatencyStats.h"
+#include "SyntheticFrameSource.h"
+
+using namespace std;
+
+// Global to keep track of if the program should run.
+// Will be set false by a SIGINT handler when ctrl-c is
+// pressed, then the main loop will cleanly exit.
+volatile bool running = true;
+
+static void sigintHandler(int s) {
+  running = false;
+}
+
+static void usage(const char* progname) {
+  std::cerr << "Usage: " << progname << " [flags] [config-file]" << std::endl;
+  std::cerr << "Sends frames of the size and to the Art-Net port and universe set in the config file." << std::endl;
+  std::cerr << "Flags:" << std::endl;
+  std::cerr << "\t-h <host>    : Address to send to (Default: 127.0.0.1)." << std::endl;
+  std::cerr << "\t-r <fps>     : Frames per second (Default: 30)." << std::endl;
+  std::cerr << "\t-n <frames>  : Number of frames to send, 0 for no limit (Default: 0)." << std::endl;
+  std::cerr << "\t-S           : Do not send ArtSync after each frame." << std::endl;
+  std::cerr << "\t-l <percent> : Drop this percentage of packets to test loss handling." << std::endl;
+}
+
+int main(int argc, char** argv) {
+  try {
+    string host = "127.0.0.1";
+    int rate = 30;
+    int frames = 0;
+    bool sync = true;
+    int loss = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:r:n:Sl:")) != -1) {
+      switch (opt) {
+      case 'h':
+        host = optarg;
+        break;
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 'n':
+        frames = atoi(optarg);
+        break;
+      case 'S':
+        sync = false;
+        break;
+      case 'l':
+        loss = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    if (rate <= 0) {
+      throw invalid_argument("Frame rate must be positive!");
+    }
+
+    rgb_matrix::RGBMatrix::Options matrix_options;
+    Config config(&matrix_options, optind < argc ? argv[optind] : "/dev/null");
+    int port = ArtNet::kPort;
+    int first_universe = 0;
+    if (config.hasArtNetSource()) {
+      port = config.getArtNetSource().port;
+      first_universe = config.getArtNetSource().universe;
+    }
+    SyntheticFrameSource source(config.getCaptureWidth(), config.getCaptureHeight());
+    const int size = source.width()*source.height()*3;
+    const int universes = (size + ArtNet::kUniverseSize - 1) / ArtNet::kUniverseSize;
+    cout << "Sending " << source.width() << "x" << source.height()
+         << " frames in " << universes << " universes from universe "
+         << first_universe << " to " << host << ":" << port << endl;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+      throw runtime_error("Unable to create socket!");
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+      throw invalid_argument("Host must be an IPv4 address!");
+    }
+
+    signal(SIGINT, sigintHandler);
+    uint8_t packet[ArtNet::kMaxPacketSize];
+    uint8_t sequence = 0;
+    int sent = 0;
+    int dropped = 0;
+    const uint64_t period = 1000000/rate;
+    uint64_t next_frame = LatencyStats::now();
+    int frame = 0;
+    for (; running && ((frames == 0) || (frame < frames)); ++frame) {
+      source.capture();
+      // Sequence numbers run 1 to 255, one per frame for all its universes.
+      sequence = (sequence % 255) + 1;
+      for (int i=0; i<universes; ++i) {
+        const int offset = i*ArtNet::kUniverseSize;
+        size_t length = ArtNet::buildDmx(packet, first_universe + i, sequence,
+                                         source.getRow(0) + offset,
+                                         min(ArtNet::kUniverseSize, size - offset));
+        if ((loss > 0) && (rand() % 100 < loss)) {
+          ++dropped;
+          continue;
+        }
+        sendto(sock, packet, length, 0, (struct sockaddr*)&address, sizeof(address));
+        ++sent;
+      }
+      if (sync) {
+        size_t length = ArtNet::buildSync(packet);
+        sendto(sock, packet, length, 0, (struct sockaddr*)&address, sizeof(address));
+      }
+      next_frame += period;
+      uint64_t now = LatencyStats::now();
+      if (now < next_frame) {
+        usleep(next_frame - now);
+      }
+    }
+    close(sock);
+    cout << "Sent " << frame << " frames, " << sent << " packets, "
+         << dropped << " dropped on purpose" << endl;
+  }
+  catch (const exception& ex) {
+    cerr << ex.what() << endl;
+    usage(argv[0]);
+    return -1;
+  }
+  return 0;
+}
@@ -2,17 +2,25 @@
 // Program to aid in the testing of LED matrix chains.
 // Author: Tony DiCola
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <led-matrix.h>
 #include <signal.h>
 #include <unistd.h>
 
+#include "BitplaneOutput.h"
 #include "Config.h"
-#include "glcdfont.h"
+#include "GlyphAtlas.h"
 #include "GridTransformer.h"
+#include "LatencyStats.h"
+#include "MemoryCanvas.h"
+#include "TextScroller.h"
 
 using namespace std;
 using namespace rgb_matrix;
@@ -23,28 +31,166 @@ using namespace rgb_matrix;
 // pressed, then the main loop will cleanly exit.
 volatile bool running = true;
 
-void printCanvas(Canvas* canvas, int x, int y, const string& message,
-                 int r = 255, int g = 255, int b = 255) {
-  // Loop through all the characters and print them starting at the provided
-  // coordinates.
-  for (auto c: message) {
-    // Loop through each column of the character.
-    for (int i=0; i<5; ++i) {
-      unsigned char col = glcdfont[c*5+i];
-      x += 1;
-      // Loop through each row of the column.
-      for (int j=0; j<8; ++j) {
-        // Put a pixel for each 1 in the column byte.
-        if ((col >> j) & 0x01) {
-          canvas->SetPixel(x, y+j, r, g, b);
-        }
+// Names of the benchmark patterns, in the order they run for 'all'.
+static const char* const kPatterns[] = { "noise", "gradient", "text", "flip" };
+
+// Draw one frame of a benchmark pattern.  Returns the number of SetPixel
+// calls it made.
+static int drawPattern(const string& pattern, Canvas* canvas, int frame) {
+  const int width = canvas->width();
+  const int height = canvas->height();
+  if (pattern == "noise") {
+    // Full-frame noise from a xorshift generator, every pixel changes.
+    static uint32_t state = 2463534242u;
+    for (int y=0; y<height; ++y) {
+      for (int x=0; x<width; ++x) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        canvas->SetPixel(x, y, state, state >> 8, state >> 16);
+      }
+    }
+    return width*height;
+  }
+  else if (pattern == "gradient") {
+    // Diagonal gradients that move a pixel every frame.
+    for (int y=0; y<height; ++y) {
+      for (int x=0; x<width; ++x) {
+        canvas->SetPixel(x, y, (x + frame)*4, (y + frame)*4, (x + y - frame)*2);
       }
     }
-    // Add a column of padding between characters.
-    x += 1;
+    return width*height;
+  }
+  else if (pattern == "text") {
+    // Lines of text scrolling to the left at different speeds.
+    static const GlyphAtlas atlas;
+    static vector<TextScroller> tickers;
+    if (tickers.empty()) {
+      for (int y=0, line=0; y+atlas.getHeight()<=height; y+=atlas.getHeight(), ++line) {
+        tickers.push_back(TextScroller(atlas,
+                                       "The quick brown fox jumps over the lazy dog.",
+                                       y, 1 + line%3, 255, 128 + line*32, 64));
+      }
+    }
+    canvas->Fill(0, 0, 0);
+    int count = 0;
+    for (auto& ticker: tickers) {
+      count += ticker.draw(canvas);
+    }
+    return count;
+  }
+  else {
+    // Rapid full-screen color flips.  Fill skips the per-pixel mapping so this
+    // shows the best update rate the chain can take.
+    static const uint8_t colors[][3] = {
+      { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }, { 255, 255, 255 }
+    };
+    const uint8_t* color = colors[frame % 4];
+    canvas->Fill(color[0], color[1], color[2]);
+    return 0;
   }
 }
 
+// Run a benchmark pattern for the given number of seconds, either as fast as
+// possible (rate of 0) or at a fixed rate, and print the results.  With a
+// direct output the pattern is drawn in memory and converted by it instead.
+static void runBenchmark(const string& pattern, RGBMatrix* matrix,
+                         GridTransformer* grid, BitplaneOutput* output,
+                         int rate, int seconds) {
+  FrameCanvas* offscreen = matrix->CreateFrameCanvas();
+  unique_ptr<MemoryCanvas> composed;
+  if (output != NULL) {
+    composed.reset(new MemoryCanvas(output->width(), output->height()));
+  }
+  // Time swaps of an untouched canvas first, each one waits for the next
+  // matrix refresh, to know how far apart the vsyncs are.
+  LatencyStats refresh_stats("refresh");
+  offscreen = matrix->SwapOnVSync(offscreen);
+  for (int i=0; i<20; ++i) {
+    uint64_t start = LatencyStats::now();
+    offscreen = matrix->SwapOnVSync(offscreen);
+    refresh_stats.add(LatencyStats::now() - start);
+  }
+  LatencyStats draw_stats("draw"),
+               swap_stats("swap"),
+               interval_stats("interval");
+  uint64_t pixels = 0;
+  int frames = 0;
+  const uint64_t period = (rate > 0) ? 1000000/rate : 0;
+  const uint64_t start = LatencyStats::now();
+  const uint64_t end = start + (uint64_t)seconds*1000000;
+  uint64_t next_frame = start;
+  uint64_t last_swap = 0;
+  vector<uint64_t> intervals;
+  while (running && (LatencyStats::now() < end)) {
+    if (period > 0) {
+      uint64_t now = LatencyStats::now();
+      if (now < next_frame) {
+        usleep(next_frame - now);
+      }
+      next_frame += period;
+    }
+    // Draw through the grid transformer onto the offscreen canvas, then swap
+    // it in on the next vsync of the matrix refresh.
+    uint64_t draw_start = LatencyStats::now();
+    if (output != NULL) {
+      pixels += drawPattern(pattern, composed.get(), frames);
+      output->write(*composed, offscreen);
+    }
+    else {
+      Canvas* canvas = (grid != NULL) ? grid->Transform(offscreen) : offscreen;
+      pixels += drawPattern(pattern, canvas, frames);
+    }
+    uint64_t drawn = LatencyStats::now();
+    offscreen = matrix->SwapOnVSync(offscreen);
+    uint64_t swapped = LatencyStats::now();
+    draw_stats.add(drawn - draw_start);
+    swap_stats.add(swapped - drawn);
+    if (last_swap > 0) {
+      interval_stats.add(swapped - last_swap);
+      intervals.push_back(swapped - last_swap);
+    }
+    last_swap = swapped;
+    ++frames;
+  }
+  const double elapsed = (LatencyStats::now() - start) / 1000000.0;
+
+  // Count dropped vsyncs as the number of extra frame periods between swaps.
+  // The expected period is the fixed rate, or the measured matrix refresh
+  // period when running as fast as possible.
+  double expected = (period > 0) ? period : refresh_stats.percentile(0.5);
+  int dropped = 0;
+  if (expected > 0) {
+    for (auto interval: intervals) {
+      int periods = (int)(interval / expected + 0.5);
+      if (periods > 1) {
+        dropped += periods - 1;
+      }
+    }
+  }
+
+  cout << "Benchmark '" << pattern << "' "
+       << ((rate > 0) ? "at fixed rate" : "as fast as possible") << ":" << endl
+       << " output: ";
+  if (output != NULL) {
+    cout << "direct with " << output->getThreads() << " threads" << endl;
+  }
+  else {
+    cout << "SetPixel" << endl;
+  }
+  cout << " frames: " << frames << " in " << elapsed << " seconds" << endl
+       << " update rate: " << frames / elapsed << " Hz" << endl
+       << " matrix refresh: " << refresh_stats.percentile(0.5) / 1000.0 << " ms" << endl;
+  // The flip pattern fills the canvas without any SetPixel calls.
+  if (pixels > 0) {
+    cout << " SetPixel throughput: " << pixels / elapsed / 1000000.0 << " Mpixels/s" << endl;
+  }
+  cout << " dropped vsyncs: " << dropped << endl;
+  draw_stats.print(cout);
+  swap_stats.print(cout);
+  interval_stats.print(cout);
+}
+
 static void sigintHandler(int s) {
   running = false;
 }
@@ -52,6 +198,11 @@ static void sigintHandler(int s) {
 static void usage(const char* progname) {
   std::cerr << "Usage: " << progname << " [flags] [config-file]" << std::endl;
   std::cerr << "Flags:" << std::endl;
+  std::cerr << "\t-b <pattern> : Run a benchmark pattern instead of labeling the panels," << std::endl
+            << "\t               one of noise, gradient, text, flip or all." << std::endl;
+  std::cerr << "\t-r <hz>      : Benchmark frame rate, 0 to run as fast as possible (Default: 0)." << std::endl;
+  std::cerr << "\t-d <seconds> : Benchmark duration of each pattern (Default: 10)." << std::endl;
+  std::cerr << "\t-D <threads> : Benchmark the direct framebuffer output with this many threads." << std::endl;
   rgb_matrix::PrintMatrixFlags(stderr);
 }
 
@@ -65,20 +216,88 @@ int main(int argc, char** argv) {
       usage(argv[0]);
       return 1;
     }
+    string benchmark;
+    int rate = 0;
+    int seconds = 10;
+    int direct_threads = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:r:d:D:")) != -1) {
+      switch (opt) {
+      case 'b':
+        benchmark = optarg;
+        break;
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 'd':
+        seconds = atoi(optarg);
+        break;
+      case 'D':
+        direct_threads = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    vector<string> patterns;
+    for (auto pattern: kPatterns) {
+      if ((benchmark == pattern) || (benchmark == "all")) {
+        patterns.push_back(pattern);
+      }
+    }
+    if (!benchmark.empty() && patterns.empty()) {
+      throw invalid_argument("Unknown benchmark pattern '" + benchmark + "'!");
+    }
 
-    Config config(&matrix_options, argc >= 2 ? argv[1] : "/dev/null");
+    Config config(&matrix_options, optind < argc ? argv[optind] : "/dev/null");
     cout << "Using config values: " << endl
          << " display_width: " << config.getDisplayWidth() << endl
          << " display_height: " << config.getDisplayHeight() << endl
          << " panel_width: " << config.getPanelWidth() << endl
          << " panel_height: " << config.getPanelHeight() << endl
          << " chain_length: " << config.getChainLength() << endl
-         << " parallel_count: " << config.getParallelCount() << endl;
+         << " parallel_count: " << config.getParallelCount() << endl
+         << " pwm_bits: " << matrix_options.pwm_bits << endl;
 
     // Initialize matrix library.
-    // Create canvas and apply GridTransformer.
     RGBMatrix *canvas = CreateMatrixFromOptions(matrix_options, runtime_options);
 
+    // In benchmark mode draw through the GridTransformer onto double buffered
+    // frame canvases, so swaps can be timed against the matrix refresh.
+    if (!patterns.empty()) {
+      GridTransformer* grid = NULL;
+      if (config.hasTransformer()) {
+        grid = new GridTransformer(config.getGridTransformer());
+      }
+      // The direct output is only benchmarked once it is checked to give
+      // bit identical framebuffers to SetPixel.
+      unique_ptr<BitplaneOutput> output;
+      if (direct_threads > 0) {
+        uint64_t start = LatencyStats::now();
+        output.reset(new BitplaneOutput(canvas, grid, direct_threads));
+        cout << "Direct output calibrated in "
+             << (LatencyStats::now() - start) / 1000 << " ms" << endl;
+        if (!output->verify()) {
+          throw runtime_error("Direct output does not match SetPixel!");
+        }
+        cout << "Direct output matches SetPixel" << endl;
+      }
+      signal(SIGINT, sigintHandler);
+      cout << "Press Ctrl-C to stop..." << endl;
+      for (auto pattern: patterns) {
+        if (running) {
+          runBenchmark(pattern, canvas, grid, output.get(), rate, seconds);
+        }
+      }
+      output.reset();
+      delete grid;
+      canvas->Clear();
+      delete canvas;
+      return 0;
+    }
+
+    // Create canvas and apply GridTransformer.
     int panel_rows = config.getParallelCount();
     int panel_columns = config.getChainLength();
     if (config.hasTransformer()) {
@@ -92,6 +311,7 @@ int main(int argc, char** argv) {
          << " grid cols: " << panel_columns << endl;
 
     // Clear the canvas, then draw on each panel.
+    GlyphAtlas atlas;
     canvas->Fill(0, 0, 0);
     for (int j=0; j<panel_rows; ++j) {
       for (int i=0; i<panel_columns; ++i) {
@@ -101,7 +321,7 @@ int main(int argc, char** argv) {
         // Print the current grid position to the top left (origin) of the panel.
         stringstream pos;
         pos << i << "," << j;
-        printCanvas(canvas, x, y, pos.str());
+        atlas.draw(canvas, x+1, y, pos.str());
       }
     }
     // Loop forever waiting for Ctrl-C signal to quit.
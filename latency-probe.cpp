@@ -0,0 +1,389 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Program to measure how long a frame takes to go from its source to the LED
+// matrices.  Every frame is stamped with a ProbeCode in a corner, the code is
+// decoded again from the output canvas and the latency of each stage of the
+// pipeline is reported.
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#ifndef NO_BCM_HOST
+#include <bcm_host.h>
+#endif
+#include <fcntl.h>
+#include <led-matrix.h>
+#include <linux/fb.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef NO_BCM_HOST
+#include "BCMDisplayCapture.h"
+#endif
+#include "Compositor.h"
+#include "Config.h"
+#include "GridTransformer.h"
+#include "LatencyStats.h"
+#include "MemoryCanvas.h"
+#include "ProbeCode.h"
+#include "SyntheticFrameSource.h"
+
+using namespace std;
+using namespace rgb_matrix;
+
+// Size of a code cell on the LED display, in pixels.  Three pixels leaves a
+// clean center sample even after the desktop is scaled down to the display.
+static const int kCellSize = 3;
+
+// Number of injected frames to remember the injection time of.
+static const int kHistory = 1024;
+
+// Global to keep track of if the program should run.
+// Will be set false by a SIGINT handler when ctrl-c is
+// pressed, then the main loop will cleanly exit.
+volatile bool running = true;
+
+// Class to draw a ProbeCode directly into the Linux framebuffer that is shown
+// on the Pi's primary display.
+class FramebufferProbe {
+public:
+  FramebufferProbe(int x, int y):
+    _x(x),
+    _y(y),
+    _cell_width(kCellSize),
+    _cell_height(kCellSize),
+    _fd(-1),
+    _size(0),
+    _data(NULL)
+  {
+    _fd = open("/dev/fb0", O_RDWR);
+    if (_fd < 0) {
+      throw runtime_error("Unable to open /dev/fb0!");
+    }
+    if (ioctl(_fd, FBIOGET_FSCREENINFO, &_fix_info) ||
+        ioctl(_fd, FBIOGET_VSCREENINFO, &_var_info)) {
+      throw runtime_error("Unable to get framebuffer information!");
+    }
+    if ((_var_info.bits_per_pixel != 16) && (_var_info.bits_per_pixel != 32)) {
+      throw runtime_error("Framebuffer must be 16 or 32 bits per pixel!");
+    }
+    _size = _fix_info.smem_len;
+    void* data = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED) {
+      throw runtime_error("Unable to map framebuffer memory!");
+    }
+    _data = (uint8_t*)data;
+  }
+
+  ~FramebufferProbe() {
+    if (_data != NULL) {
+      munmap(_data, _size);
+    }
+    if (_fd >= 0) {
+      close(_fd);
+    }
+  }
+
+  int width() const {
+    return _var_info.xres;
+  }
+  int height() const {
+    return _var_info.yres;
+  }
+  void setCellSize(int cell_width, int cell_height) {
+    _cell_width = cell_width;
+    _cell_height = cell_height;
+  }
+
+  void draw(uint16_t sequence) {
+    ProbeCode::encode(sequence, [this](int col, int row, bool on) {
+      for (int y=_y+row*_cell_height; y<_y+(row+1)*_cell_height; ++y) {
+        if ((y < 0) || (y >= (int)_var_info.yres)) {
+          continue;
+        }
+        uint8_t* line = _data + y*_fix_info.line_length;
+        for (int x=_x+col*_cell_width; x<_x+(col+1)*_cell_width; ++x) {
+          if ((x < 0) || (x >= (int)_var_info.xres)) {
+            continue;
+          }
+          if (_var_info.bits_per_pixel == 16) {
+            ((uint16_t*)line)[x] = on ? 0xFFFF : 0x0000;
+          }
+          else {
+            ((uint32_t*)line)[x] = on ? 0xFFFFFFFF : 0xFF000000;
+          }
+        }
+      }
+    });
+  }
+
+private:
+  int _x,
+      _y,
+      _cell_width,
+      _cell_height,
+      _fd;
+  size_t _size;
+  uint8_t* _data;
+  struct fb_fix_screeninfo _fix_info;
+  struct fb_var_screeninfo _var_info;
+};
+
+static void sigintHandler(int s) {
+  running = false;
+}
+
+static void usage(const char* progname) {
+  std::cerr << "Usage: " << progname << " [flags] [config-file]" << std::endl;
+  std::cerr << "Flags:" << std::endl;
+  std::cerr << "\t-s <source>  : Frame source, 'synthetic' (default) or 'display'." << std::endl;
+  std::cerr << "\t-e           : Emulate the LED matrices in memory instead of driving them." << std::endl;
+  std::cerr << "\t-n <frames>  : Number of frames to measure (Default: 500)." << std::endl;
+  std::cerr << "\t-r <hz>      : Frame rate, 0 to run as fast as possible (Default: 40)." << std::endl;
+  rgb_matrix::RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_options;
+  runtime_options.drop_privileges = -1;  // Need root
+  rgb_matrix::PrintMatrixFlags(stderr, matrix_options, runtime_options);
+}
+
+int main(int argc, char** argv) {
+  try {
+    // Initialize from flags.
+    rgb_matrix::RGBMatrix::Options matrix_options;
+    rgb_matrix::RuntimeOptions runtime_options;
+    runtime_options.drop_privileges = -1;  // Need root
+    if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                           &matrix_options, &runtime_options)) {
+      usage(argv[0]);
+      return 1;
+    }
+    string source_name = "synthetic";
+    bool emulate = false;
+    int frames = 500;
+    int rate = 40;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:en:r:")) != -1) {
+      switch (opt) {
+      case 's':
+        source_name = optarg;
+        break;
+      case 'e':
+        emulate = true;
+        break;
+      case 'n':
+        frames = atoi(optarg);
+        break;
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    if ((source_name != "synthetic") && (source_name != "display")) {
+      throw invalid_argument("Frame source must be 'synthetic' or 'display'!");
+    }
+
+    Config config(&matrix_options, optind < argc ? argv[optind] : "/dev/null");
+    const int display_width = config.getDisplayWidth();
+    const int display_height = config.getDisplayHeight();
+    cout << "Using config values: " << endl
+         << " display_width: " << display_width << endl
+         << " display_height: " << display_height << endl
+         << " panel_width: " << config.getPanelWidth() << endl
+         << " panel_height: " << config.getPanelHeight() << endl
+         << " chain_length: " << config.getChainLength() << endl
+         << " parallel_count: " << config.getParallelCount() << endl;
+    // The code is stamped at the origin of the first window and read back
+    // from where that window lands on the display.
+    vector<Compositor::Window> windows = config.getWindows();
+    const Compositor::Window& probe_window = windows[0];
+    if ((probe_window.width < ProbeCode::kColumns*kCellSize) ||
+        (probe_window.height < ProbeCode::kRows*kCellSize)) {
+      throw invalid_argument("Display is too small to hold the probe code!");
+    }
+    Compositor compositor(display_width, display_height, windows);
+
+    // Set up the frame source.  The display source captures the Pi's primary
+    // display the same way rpi-fb-matrix does and stamps the code into the
+    // Linux framebuffer so it travels through the whole GPU path.
+    unique_ptr<FrameSource> source;
+    unique_ptr<FramebufferProbe> fb_probe;
+    SyntheticFrameSource* synthetic = NULL;
+    if (source_name == "display") {
+#ifdef NO_BCM_HOST
+      throw invalid_argument("Built without bcm_host, the display source is not available!");
+#else
+      // The GPU flips for a display transform would move the stamped code
+      // away from where it is read back, and cost nothing to measure.
+      if (config.getSnapshotFlipHorizontal() || config.getSnapshotFlipVertical()) {
+        throw invalid_argument("The display source can not be used with a display_transform that flips the screen!");
+      }
+      bcm_host_init();
+      if (config.hasCropOrigin() || config.hasWindows()) {
+        source.reset(new BCMDisplayCapture());
+        fb_probe.reset(new FramebufferProbe(probe_window.source_x, probe_window.source_y));
+      }
+      else {
+        const int capture_width = config.getCaptureWidth();
+        const int capture_height = config.getCaptureHeight();
+        source.reset(new BCMDisplayCapture(capture_width, capture_height));
+        // Scale the code cells up so they are still kCellSize pixels once
+        // the desktop is resized down to the capture size.
+        fb_probe.reset(new FramebufferProbe(0, 0));
+        fb_probe->setCellSize(
+          (fb_probe->width()*kCellSize + capture_width-1) / capture_width,
+          (fb_probe->height()*kCellSize + capture_height-1) / capture_height);
+      }
+#endif
+    }
+    else {
+      // Make the synthetic frames big enough to hold every window.
+      int source_width = display_width;
+      int source_height = display_height;
+      for (auto& window: windows) {
+        source_width = max(source_width, window.source_x + window.width);
+        source_height = max(source_height, window.source_y + window.height);
+      }
+      synthetic = new SyntheticFrameSource(source_width, source_height);
+      source.reset(synthetic);
+    }
+    compositor.plan(source->width(), source->height());
+
+    // Set up the output.  Pixels always go to a MemoryCanvas so the code can
+    // be read back, which forwards them to the matrix when one is attached.
+    RGBMatrix* matrix = NULL;
+    FrameCanvas* offscreen = NULL;
+    unique_ptr<MemoryCanvas> output;
+    if (emulate) {
+      output.reset(new MemoryCanvas(config.getPanelWidth()*config.getChainLength(),
+                                    config.getPanelHeight()*config.getParallelCount()));
+    }
+    else {
+      matrix = CreateMatrixFromOptions(matrix_options, runtime_options);
+      if (matrix == NULL) {
+        throw runtime_error("Unable to create LED matrix!");
+      }
+      offscreen = matrix->CreateFrameCanvas();
+      output.reset(new MemoryCanvas(offscreen->width(), offscreen->height(), offscreen));
+    }
+    unique_ptr<GridTransformer> grid;
+    Canvas* canvas = output.get();
+    if (config.hasTransformer()) {
+      grid.reset(new GridTransformer(config.getGridTransformer()));
+      canvas = grid->Transform(output.get());
+    }
+
+    LatencyStats inject_stats("inject"),
+                 capture_stats("capture"),
+                 map_stats("map"),
+                 present_stats("present"),
+                 decode_stats("decode"),
+                 total_stats("end-to-end");
+    vector<uint64_t> inject_times(kHistory, 0);
+    int decoded = 0,
+        failed = 0,
+        repeated = 0;
+    bool have_last = false;
+    uint16_t last_sequence = 0;
+
+    signal(SIGINT, sigintHandler);
+    cout << "Measuring " << frames << " frames from " << source_name
+         << " source, press Ctrl-C to stop early..." << endl;
+    for (int i=0; running && (i<frames); ++i) {
+      uint64_t frame_start = LatencyStats::now();
+      // Inject the code for this frame.
+      uint16_t sequence = i;
+      if (fb_probe) {
+        fb_probe->draw(sequence);
+      }
+      else {
+        synthetic->setProbeCode(sequence, kCellSize,
+                                probe_window.source_x, probe_window.source_y);
+      }
+      uint64_t injected = LatencyStats::now();
+      inject_times[sequence % kHistory] = injected;
+      // Capture the frame.
+      source->capture();
+      uint64_t captured = LatencyStats::now();
+      // Map it to the LED display the same way rpi-fb-matrix does.
+      compositor.render(*source, canvas);
+      uint64_t mapped = LatencyStats::now();
+      // Present it on the next refresh of the matrix.
+      if (matrix != NULL) {
+        offscreen = matrix->SwapOnVSync(offscreen);
+        output->setDelegate(offscreen);
+      }
+      uint64_t presented = LatencyStats::now();
+      // Read the code back from the output canvas, following the panel layout
+      // to find where each code cell landed.
+      uint16_t received;
+      bool valid = ProbeCode::decode([&](int col, int row) {
+        int x = probe_window.dest_x + (col*kCellSize*2 + kCellSize)*probe_window.scale/2;
+        int y = probe_window.dest_y + (row*kCellSize*2 + kCellSize)*probe_window.scale/2;
+        if (grid) {
+          grid->mapPixel(x, y, &x, &y);
+        }
+        uint8_t red, green, blue;
+        output->getPixel(x, y, &red, &green, &blue);
+        return ProbeCode::isOn(red, green, blue);
+      }, &received);
+      uint64_t done = LatencyStats::now();
+
+      inject_stats.add(injected - frame_start);
+      capture_stats.add(captured - injected);
+      map_stats.add(mapped - captured);
+      present_stats.add(presented - mapped);
+      decode_stats.add(done - presented);
+      if (!valid) {
+        ++failed;
+      }
+      else if (have_last && (received == last_sequence)) {
+        // The source has not picked up a new frame yet.
+        ++repeated;
+      }
+      else {
+        ++decoded;
+        total_stats.add(presented - inject_times[received % kHistory]);
+        last_sequence = received;
+        have_last = true;
+      }
+
+      if (rate > 0) {
+        uint64_t elapsed = LatencyStats::now() - frame_start;
+        if (elapsed < 1000000u/rate) {
+          usleep(1000000u/rate - elapsed);
+        }
+      }
+    }
+
+    cout << "Frames decoded: " << decoded
+         << ", repeated: " << repeated
+         << ", undecodable: " << failed << endl;
+    cout << "Stage latencies:" << endl;
+    inject_stats.print(cout);
+    capture_stats.print(cout);
+    map_stats.print(cout);
+    present_stats.print(cout);
+    decode_stats.print(cout);
+    total_stats.print(cout);
+
+    if (matrix != NULL) {
+      matrix->Clear();
+      delete matrix;
+    }
+  }
+  catch (const exception& ex) {
+    cerr << ex.what() << endl;
+    usage(argv[0]);
+    return -1;
+  }
+  return 0;
+}
@@ -2,9 +2,13 @@
 // Program to copy the contents of the Raspberry Pi primary display to LED matrices.
 // Author: Tony DiCola
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
+#ifndef NO_BCM_HOST
 #include <bcm_host.h>
+#endif
 #include <fcntl.h>
 #include <led-matrix.h>
 #include <linux/fb.h>
@@ -14,8 +18,21 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "ArtNetFrameSource.h"
+#include "AsyncFrameSource.h"
+#ifndef NO_BCM_HOST
+#include "BCMDisplayCapture.h"
+#endif
+#include "BitplaneOutput.h"
+#include "Compositor.h"
 #include "Config.h"
+#include "Dither.h"
+#include "FrameInterpolator.h"
+#include "GlyphAtlas.h"
 #include "GridTransformer.h"
+#include "LatencyStats.h"
+#include "MemoryCanvas.h"
+#include "TextScroller.h"
 
 using namespace std;
 using namespace rgb_matrix;
@@ -25,85 +42,6 @@ using namespace rgb_matrix;
 // pressed, then the main loop will cleanly exit.
 volatile bool running = true;
 
-// Class to encapsulate all the logic for capturing an image of the Pi's primary
-// display.  Manages all the BCM GPU and CPU resources automatically while in scope.
-class BCMDisplayCapture {
-public:
-  BCMDisplayCapture(int width=-1, int height=-1):
-    _width(width),
-    _height(height),
-    _display(0),
-    _screen_resource(0),
-    _screen_data(NULL)
-  {
-    // Get information about primary/HDMI display.
-    _display = vc_dispmanx_display_open(0);
-    if (!_display) {
-      throw runtime_error("Unable to open primary display!");
-    }
-    DISPMANX_MODEINFO_T display_info;
-    if (vc_dispmanx_display_get_info(_display, &display_info)) {
-      throw runtime_error("Unable to get primary display information!");
-    }
-    cout << "Primary display:" << endl
-         << " resolution: " << display_info.width << "x" << display_info.height << endl
-         << " format: " << display_info.input_format << endl;
-    // If no width and height were specified then grab the entire screen.
-    if ((_width == -1) || (_height == -1)) {
-      _width = display_info.width;
-      _height = display_info.height;
-    }
-    // Create a GPU image surface to hold the captured screen.
-    uint32_t image_prt;
-    _screen_resource = vc_dispmanx_resource_create(VC_IMAGE_RGB888, _width, _height, &image_prt);
-    if (!_screen_resource) {
-      throw runtime_error("Unable to create screen surface!");
-    }
-    // Create a rectangular region of the captured screen size.
-    vc_dispmanx_rect_set(&_rect, 0, 0, _width, _height);
-    // Allocate CPU memory for copying out the captured screen.  Must be aligned
-    // to a larger size because of GPU surface memory size constraints.
-    _pitch = ALIGN_UP(_width*3, 32);
-    _screen_data = new uint8_t[_pitch*_height];
-  }
-
-  void capture() {
-    // Capture the primary display and copy it from GPU to CPU memory.
-    vc_dispmanx_snapshot(_display, _screen_resource, (DISPMANX_TRANSFORM_T)0);
-    vc_dispmanx_resource_read_data(_screen_resource, &_rect, _screen_data, _pitch);
-  }
-
-  void getPixel(int x, int y, uint8_t* r, uint8_t* g, uint8_t* b) {
-    // Grab the requested pixel from the last captured display image.
-    uint8_t* row = _screen_data + (y*_pitch);
-    *r = row[x*3];
-    *g = row[x*3+1];
-    *b = row[x*3+2];
-  }
-
-  ~BCMDisplayCapture() {
-    // Clean up BCM and other resources.
-    if (_screen_resource != 0) {
-      vc_dispmanx_resource_delete(_screen_resource);
-    }
-    if (_display != 0) {
-      vc_dispmanx_display_close(_display);
-    }
-    if (_screen_data != NULL) {
-      delete[] _screen_data;
-    }
-  }
-
-private:
-  int _width,
-      _height,
-      _pitch;
-  DISPMANX_DISPLAY_HANDLE_T _display;
-  DISPMANX_RESOURCE_HANDLE_T _screen_resource;
-  VC_RECT_T _rect;
-  uint8_t* _screen_data;
-};
-
 static void sigintHandler(int s) {
   running = false;
 }
@@ -111,6 +49,7 @@ static void sigintHandler(int s) {
 static void usage(const char* progname) {
     std::cerr << "Usage: " << progname << " [flags] [config-file]" << std::endl;
     std::cerr << "Flags:" << std::endl;
+    std::cerr << "\t-e           : Emulate the LED matrices in memory instead of driving them." << std::endl;
     rgb_matrix::RGBMatrix::Options matrix_options;
     rgb_matrix::RuntimeOptions runtime_options;
     runtime_options.drop_privileges = -1;  // Need root
@@ -128,9 +67,21 @@ int main(int argc, char** argv) {
       usage(argv[0]);
       return 1;
     }
+    bool emulate = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "e")) != -1) {
+      switch (opt) {
+      case 'e':
+        emulate = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+      }
+    }
 
     // Read additional configuration from config file if it exists
-    Config config(&matrix_options, argc >= 2 ? argv[1] : "/dev/null");
+    Config config(&matrix_options, optind < argc ? argv[optind] : "/dev/null");
     cout << "Using config values: " << endl
          << " display_width: " << config.getDisplayWidth() << endl
          << " display_height: " << config.getDisplayHeight() << endl
@@ -139,55 +90,276 @@ int main(int argc, char** argv) {
          << " chain_length: " << config.getChainLength() << endl
          << " parallel_count: " << config.getParallelCount() << endl;
 
-    // Set screen capture state depending on if a crop region is specified or not.
-    // When not cropped grab the entire screen and resize it down to the LED display.
-    // However when cropping is enabled instead grab the entire screen (by
-    // setting the capture_width and capture_height to -1) and specify an offset
-    // to the start of the crop rectangle.
-    int capture_width = config.getDisplayWidth();
-    int capture_height = config.getDisplayHeight();
-    int x_offset = 0;
-    int y_offset = 0;
+    // Set screen capture state depending on if a crop region or windows are
+    // specified or not.  When not cropped grab the entire screen and resize it
+    // down to the LED display.  However when cropping is enabled or windows
+    // are used instead grab the entire screen (by setting the capture_width
+    // and capture_height to -1) and let the compositor copy the regions out of
+    // it.  Either way one capture per frame feeds all of the windows.  With a
+    // capture scale the resized screen is captured at a fraction of the display
+    // size and scaled back up while mapping, cutting the GPU readback.
+    int capture_width = config.getCaptureWidth();
+    int capture_height = config.getCaptureHeight();
+    if (config.getCaptureScale() > 1) {
+      cout << " capture_scale: " << config.getCaptureScale() << endl;
+    }
     if (config.hasCropOrigin()) {
       cout << " crop_origin: (" << config.getCropX() << ", " << config.getCropY() << ")" << endl;
       capture_width = -1;
       capture_height = -1;
-      x_offset = config.getCropX();
-      y_offset = config.getCropY();
+    }
+    if (config.hasWindows()) {
+      for (auto& window: config.getWindows()) {
+        cout << " window: (" << window.source_x << ", " << window.source_y << ") "
+             << window.width << "x" << window.height << " -> ("
+             << window.dest_x << ", " << window.dest_y << ") scale "
+             << window.scale << endl;
+      }
+      capture_width = -1;
+      capture_height = -1;
+    }
+    Compositor compositor(config.getDisplayWidth(), config.getDisplayHeight(),
+                          config.getWindows());
+
+    const Config::DisplayTransform& display_transform = config.getDisplayTransform();
+    if ((display_transform.rotate != 0) || display_transform.flip_horizontal ||
+        display_transform.flip_vertical) {
+      cout << " display_transform: rotate " << display_transform.rotate
+           << (display_transform.flip_horizontal ? ", flip horizontal" : "")
+           << (display_transform.flip_vertical ? ", flip vertical" : "") << endl;
     }
 
+    // Dither the copied screen down to the levels the configured PWM bits
+    // can show, if enabled.
+    unique_ptr<Dither> dither;
+    if (config.hasDither()) {
+      cout << " dither: " << matrix_options.pwm_bits << " pwm bits" << endl;
+      dither.reset(new Dither(matrix_options.pwm_bits, matrix_options.brightness));
+      compositor.setDither(dither.get());
+    }
 
     // Initialize matrix library.
-    // Create canvas and apply GridTransformer.
-    RGBMatrix *canvas = CreateMatrixFromOptions(matrix_options, runtime_options);
+    // Create the matrix and an offscreen canvas that each frame is drawn on
+    // through the GridTransformer, so the captured screen and any overlay
+    // show up together on the next matrix refresh.  When emulating, frames
+    // are drawn on a canvas in memory the size of the chains instead.
+    RGBMatrix *matrix = NULL;
+    FrameCanvas *offscreen = NULL;
+    unique_ptr<MemoryCanvas> emulated;
+    if (emulate) {
+      emulated.reset(new MemoryCanvas(config.getPanelWidth()*config.getChainLength(),
+                                      config.getPanelHeight()*config.getParallelCount()));
+    }
+    else {
+      matrix = CreateMatrixFromOptions(matrix_options, runtime_options);
+      matrix->Clear();
+      offscreen = matrix->CreateFrameCanvas();
+    }
+    unique_ptr<GridTransformer> grid;
     if (config.hasTransformer()) {
-      canvas->ApplyStaticTransformer(config.getGridTransformer());
+      grid.reset(new GridTransformer(config.getGridTransformer()));
+    }
+    // With the direct output frames are instead composed in memory and
+    // converted straight into the offscreen canvas' framebuffer when shown,
+    // once it is checked to match drawing them with SetPixel.
+    unique_ptr<BitplaneOutput> bitplanes;
+    unique_ptr<MemoryCanvas> composed;
+    if ((config.getDirectOutputThreads() > 0) && (matrix != NULL)) {
+      cout << " direct_output_threads: " << config.getDirectOutputThreads() << endl;
+      try {
+        bitplanes.reset(new BitplaneOutput(matrix, grid.get(),
+                                           config.getDirectOutputThreads()));
+        if (!bitplanes->verify()) {
+          throw runtime_error("Direct output does not match SetPixel!");
+        }
+        composed.reset(new MemoryCanvas(bitplanes->width(), bitplanes->height()));
+      }
+      catch (const runtime_error& ex) {
+        cerr << ex.what() << " Drawing with SetPixel instead." << endl;
+        bitplanes.reset();
+      }
     }
-    canvas->Clear();
+    // Get the canvas to draw the next frame on, and show it once drawn.
+    auto frameCanvas = [&]() -> Canvas* {
+      if (bitplanes) {
+        return composed.get();
+      }
+      Canvas* canvas = emulate ? (Canvas*)emulated.get() : offscreen;
+      return grid ? grid->Transform(canvas) : canvas;
+    };
+    auto swapFrame = [&]() {
+      if (bitplanes) {
+        bitplanes->write(*composed, offscreen);
+      }
+      if (matrix != NULL) {
+        offscreen = matrix->SwapOnVSync(offscreen);
+      }
+    };
+
+    // Set up the optional ticker drawn over the captured screen.
+    unique_ptr<GlyphAtlas> atlas;
+    unique_ptr<TextScroller> ticker;
+    if (config.hasTicker()) {
+      const Config::Ticker& settings = config.getTicker();
+      cout << " ticker: \"" << settings.text << "\"" << endl;
+      atlas.reset(new GlyphAtlas(settings.scale));
+      ticker.reset(new TextScroller(*atlas, settings.text, settings.y,
+                                    settings.speed, settings.red,
+                                    settings.green, settings.blue));
+    }
+
+    // Set up the frame source, either frames received over the network with
+    // Art-Net (at the capture size) or the Pi's primary display.
+    unique_ptr<FrameSource> source;
+    ArtNetFrameSource* artnet = NULL;
+    AsyncFrameSource* capture = NULL;
+    if (config.hasArtNetSource()) {
+      const Config::ArtNetSource& settings = config.getArtNetSource();
+      cout << " artnet: port " << settings.port << ", universe "
+           << settings.universe << ", timeout " << settings.timeout_ms
+           << "ms" << endl;
+      if (config.hasShard()) {
+        cout << " shard: (" << config.getShard().x << ", " << config.getShard().y
+             << ") of the virtual display" << endl;
+      }
+      artnet = new ArtNetFrameSource(capture_width, capture_height, settings.port,
+                                     settings.universe, settings.timeout_ms);
+      source.reset(artnet);
+    }
+    else {
+#ifdef NO_BCM_HOST
+      throw invalid_argument("Built without bcm_host, only the artnet frame source is available!");
+#else
+      // Flip the screen on the GPU as it is captured for the display
+      // transform, any quarter turn is already folded into the panel layout.
+      int snapshot_transform = DISPMANX_NO_ROTATE;
+      if (config.getSnapshotFlipHorizontal()) {
+        snapshot_transform |= DISPMANX_FLIP_HRIZ;
+      }
+      if (config.getSnapshotFlipVertical()) {
+        snapshot_transform |= DISPMANX_FLIP_VERT;
+      }
+      // Initialize BCM functions and display capture class.  Unless disabled
+      // the display is captured on a separate thread with a deadline, so a
+      // busy GPU shows up as a repeated frame rather than a frozen wall.
+      bcm_host_init();
+      if (config.getCaptureDeadline() > 0) {
+        cout << " capture_deadline_ms: " << config.getCaptureDeadline() << endl;
+        capture = new AsyncFrameSource([=]() {
+          return new BCMDisplayCapture(capture_width, capture_height,
+                                       (DISPMANX_TRANSFORM_T)snapshot_transform);
+        }, config.getCaptureDeadline());
+        source.reset(capture);
+      }
+      else {
+        source.reset(new BCMDisplayCapture(capture_width, capture_height,
+                                           (DISPMANX_TRANSFORM_T)snapshot_transform));
+      }
+#endif
+    }
+    compositor.plan(source->width(), source->height());
 
-    // Initialize BCM functions and display capture class.
-    bcm_host_init();
-    BCMDisplayCapture displayCapture(capture_width, capture_height);
+    // With frame interpolation the windows are first composed onto an in
+    // memory frame.  The interpolator's thread then draws that frame, or a
+    // blend of it with the previous one, on the matrix through a second
+    // compositor that copies it one to one.  Dithering moves to that second
+    // compositor so the blended frames are dithered too.
+    unique_ptr<Compositor> output;
+    unique_ptr<FrameInterpolator> interpolator;
+    if (config.getFrameInterpolation() > 1) {
+      cout << " frame_interpolation: " << config.getFrameInterpolation() << endl;
+      Compositor::Window window = { 0, 0, config.getDisplayWidth(), config.getDisplayHeight(), 0, 0, 1 };
+      output.reset(new Compositor(config.getDisplayWidth(), config.getDisplayHeight(),
+                                  vector<Compositor::Window>(1, window)));
+      output->plan(config.getDisplayWidth(), config.getDisplayHeight());
+      output->setDither(dither.get());
+      compositor.setDither(NULL);
+      interpolator.reset(new FrameInterpolator(
+        config.getDisplayWidth(), config.getDisplayHeight(),
+        config.getFrameInterpolation(),
+        [&](const FrameSource& frame) {
+          Canvas* canvas = frameCanvas();
+          output->render(frame, canvas);
+          swapFrame();
+        }));
+    }
 
     // Loop forever waiting for Ctrl-C signal to quit.
     signal(SIGINT, sigintHandler);
     cout << "Press Ctrl-C to quit..." << endl;
+    uint64_t last_report = LatencyStats::now();
     while (running) {
-      // Capture the current display image.
-      displayCapture.capture();
-      // Loop through the frame data and set the pixels on the matrix canvas.
-      for (int y=0; y<config.getDisplayHeight(); ++y) {
-        for (int x=0; x<config.getDisplayWidth(); ++x) {
-          uint8_t red, green, blue;
-          displayCapture.getPixel(x+x_offset, y+y_offset, &red, &green, &blue);
-          canvas->SetPixel(x, y, red, green, blue);
+      if (artnet != NULL) {
+        // Show network frames as soon as they are complete, reporting the
+        // packet loss and reassembly latency every 10 seconds.
+        if (LatencyStats::now() - last_report > 10000000) {
+          artnet->printStats(cout);
+          last_report = LatencyStats::now();
+        }
+        if (!artnet->waitForFrame(100) || !artnet->capture()) {
+          continue;
+        }
+      }
+      else {
+        // Capture the current display image.  If the capture fails or runs
+        // past its deadline the last good frame is shown again, and any
+        // stalls are reported every 10 seconds.
+        source->capture();
+        if ((capture != NULL) && (LatencyStats::now() - last_report > 10000000)) {
+          capture->printStats(cout);
+          last_report = LatencyStats::now();
         }
       }
-      // Sleep for 25 milliseconds (40Hz refresh)
-      usleep(25 * 1000);
+      if (interpolator) {
+        // Hand the composed frame to the interpolator to present.  The
+        // ticker is drawn on the captured frame so it moves once per capture
+        // rather than once per presented frame.
+        compositor.render(*source, interpolator->getInput());
+        if (ticker) {
+          ticker->draw(interpolator->getInput());
+        }
+        interpolator->push();
+      }
+      else {
+        // Copy the windows of the frame to the matrix canvas.
+        Canvas* canvas = frameCanvas();
+        compositor.render(*source, canvas);
+        if (ticker) {
+          ticker->draw(canvas);
+        }
+        // As a node of a sharded display hold the frame until the present
+        // time the coordinator gave it, so all the nodes swap together, and
+        // report back when it was shown.
+        const uint64_t present_time = (artnet != NULL) ? artnet->getPresentTime() : 0;
+        if (present_time != 0) {
+          uint64_t now = LatencyStats::now();
+          if (now < present_time) {
+            usleep(present_time - now);
+          }
+        }
+        swapFrame();
+        if (present_time != 0) {
+          artnet->acknowledge(LatencyStats::now());
+        }
+      }
+      if (artnet == NULL) {
+        // Sleep for 25 milliseconds (40Hz refresh)
+        usleep(25 * 1000);
+      }
+    }
+    if (artnet != NULL) {
+      artnet->printStats(cout);
+    }
+    if (capture != NULL) {
+      capture->printStats(cout);
+    }
+    // Stop the interpolator and output threads before the matrix goes away.
+    interpolator.reset();
+    bitplanes.reset();
+    if (matrix != NULL) {
+      matrix->Clear();
+      delete matrix;
     }
-    canvas->Clear();
-    delete canvas;
   }
   catch (const exception& ex) {
     cerr << ex.what() << endl;
@@ -0,0 +1,333 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Program to drive a large virtual display sharded across several Pis, each
+// running rpi-fb-matrix with the tile it shows described in its config file.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#ifndef NO_BCM_HOST
+#include <bcm_host.h>
+#endif
+#include <led-matrix.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ArtNet.h"
+#ifndef NO_BCM_HOST
+#include "BCMDisplayCapture.h"
+#endif
+#include "Config.h"
+#include "LatencyStats.h"
+#include "ShardProtocol.h"
+#include "SyntheticFrameSource.h"
+
+using namespace std;
+
+// Global to keep track of if the program should run.
+// Will be set false by a SIGINT handler when ctrl-c is
+// pressed, then the main loop will cleanly exit.
+volatile bool running = true;
+
+static void sigintHandler(int s) {
+  running = false;
+}
+
+// Number of recent frames that acks are collected for.  A frame is counted
+// as missed by the nodes that have not acked it when its slot is reused.
+static const int kPendingFrames = 64;
+
+// A node of the sharded display and its tile of the virtual display.
+struct Node {
+  string config_file;
+  struct sockaddr_in address;
+  int x,
+      y,
+      width,
+      height,
+      first_universe,
+      missed;
+  // Frames are only counted as missed after the first one the node answered,
+  // so the nodes can be started in any order.
+  uint32_t first_answered;
+  // The tile packed row by row for sending.
+  vector<uint8_t> tile;
+  LatencyStats late;
+
+  Node(): late("late") {}
+};
+
+// Times the nodes reported showing a frame, to measure the skew between them.
+struct PendingFrame {
+  uint32_t frame;
+  uint64_t present_time;
+  vector<uint64_t> shown;
+  int acked;
+};
+
+static void usage(const char* progname) {
+  std::cerr << "Usage: " << progname << " [flags] node-config-file..." << std::endl;
+  std::cerr << "Each node config file must have a shard and an artnet group." << std::endl;
+  std::cerr << "Flags:" << std::endl;
+  std::cerr << "\t-s <source>  : Frame source, synthetic or display (Default: synthetic)." << std::endl;
+  std::cerr << "\t-r <fps>     : Frames per second (Default: 30)." << std::endl;
+  std::cerr << "\t-n <frames>  : Number of frames to send, 0 for no limit (Default: 0)." << std::endl;
+  std::cerr << "\t-d <ms>      : Delay from sending a frame to presenting it (Default: 20)." << std::endl;
+}
+
+// Collect the acks waiting on the socket.
+static void receiveAcks(int sock, vector<Node>& nodes,
+                        vector<PendingFrame>& pending) {
+  uint8_t buffer[ShardProtocol::kPacketSize];
+  struct sockaddr_in sender;
+  socklen_t sender_size = sizeof(sender);
+  ssize_t size;
+  while ((size = recvfrom(sock, buffer, sizeof(buffer), MSG_DONTWAIT,
+                          (struct sockaddr*)&sender, &sender_size)) > 0) {
+    sender_size = sizeof(sender);
+    ShardProtocol::Packet packet;
+    if (!ShardProtocol::parse(buffer, size, &packet) ||
+        (packet.type != ShardProtocol::kAck)) {
+      continue;
+    }
+    PendingFrame& frame = pending[packet.frame % kPendingFrames];
+    if (frame.frame != packet.frame) {
+      continue;
+    }
+    for (size_t i=0; i<nodes.size(); ++i) {
+      if ((nodes[i].address.sin_port == sender.sin_port) &&
+          (nodes[i].address.sin_addr.s_addr == sender.sin_addr.s_addr) &&
+          (frame.shown[i] == 0)) {
+        frame.shown[i] = packet.present_time;
+        ++frame.acked;
+        if (nodes[i].first_answered == 0) {
+          nodes[i].first_answered = packet.frame;
+        }
+        nodes[i].late.add(packet.present_time > frame.present_time
+                          ? packet.present_time - frame.present_time : 0);
+      }
+    }
+  }
+}
+
+// Retire a frame: record the skew between the nodes if they all showed it,
+// otherwise count it as missed by the ones that did not.
+static void retire(PendingFrame& frame, vector<Node>& nodes,
+                   LatencyStats& skew) {
+  if (frame.frame == 0) {
+    return;
+  }
+  if (frame.acked == (int)nodes.size()) {
+    uint64_t first = *min_element(frame.shown.begin(), frame.shown.end());
+    uint64_t last = *max_element(frame.shown.begin(), frame.shown.end());
+    skew.add(last - first);
+  }
+  else {
+    for (size_t i=0; i<nodes.size(); ++i) {
+      if ((frame.shown[i] == 0) && (nodes[i].first_answered != 0) &&
+          (frame.frame > nodes[i].first_answered)) {
+        ++nodes[i].missed;
+      }
+    }
+  }
+  frame.frame = 0;
+}
+
+// Print and reset the skew between the nodes and how late each one was.
+static void printStats(vector<Node>& nodes, LatencyStats& skew, int frames) {
+  cout << "Sent " << frames << " frames to " << nodes.size() << " nodes" << endl;
+  skew.print(cout);
+  skew.clear();
+  for (auto& node: nodes) {
+    cout << " " << node.config_file << ": " << node.missed << " frames missed" << endl;
+    node.late.print(cout);
+    node.late.clear();
+    node.missed = 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  try {
+    string source_name = "synthetic";
+    int rate = 30;
+    int frames = 0;
+    int delay_ms = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:n:d:")) != -1) {
+      switch (opt) {
+      case 's':
+        source_name = optarg;
+        break;
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 'n':
+        frames = atoi(optarg);
+        break;
+      case 'd':
+        delay_ms = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    if (optind >= argc) {
+      throw invalid_argument("At least one node config file is needed!");
+    }
+    if ((rate <= 0) || (delay_ms < 0)) {
+      throw invalid_argument("Frame rate must be positive and delay not negative!");
+    }
+
+    // Read the tile of each node, the virtual display covers all of them.
+    vector<Node> nodes(argc - optind);
+    int virtual_width = 0;
+    int virtual_height = 0;
+    for (size_t i=0; i<nodes.size(); ++i) {
+      Node& node = nodes[i];
+      node.config_file = argv[optind + i];
+      rgb_matrix::RGBMatrix::Options matrix_options;
+      Config config(&matrix_options, node.config_file);
+      if (!config.hasShard()) {
+        throw invalid_argument(node.config_file + " has no shard settings!");
+      }
+      node.x = config.getShard().x;
+      node.y = config.getShard().y;
+      node.width = config.getDisplayWidth();
+      node.height = config.getDisplayHeight();
+      node.first_universe = config.getArtNetSource().universe;
+      node.missed = 0;
+      node.first_answered = 0;
+      node.tile.resize(node.width*node.height*3);
+      memset(&node.address, 0, sizeof(node.address));
+      node.address.sin_family = AF_INET;
+      node.address.sin_port = htons(config.getArtNetSource().port);
+      if (inet_pton(AF_INET, config.getShard().host.c_str(),
+                    &node.address.sin_addr) != 1) {
+        throw invalid_argument(node.config_file + " shard host must be an IPv4 address!");
+      }
+      virtual_width = max(virtual_width, node.x + node.width);
+      virtual_height = max(virtual_height, node.y + node.height);
+      cout << "Node " << node.config_file << ": " << node.width << "x"
+           << node.height << " tile at (" << node.x << ", " << node.y
+           << ") sent to " << config.getShard().host << ":"
+           << config.getArtNetSource().port << endl;
+    }
+    cout << "Virtual display: " << virtual_width << "x" << virtual_height << endl;
+
+    unique_ptr<FrameSource> source;
+    if (source_name == "synthetic") {
+      source.reset(new SyntheticFrameSource(virtual_width, virtual_height));
+    }
+    else if (source_name == "display") {
+#ifdef NO_BCM_HOST
+      throw invalid_argument("Built without bcm_host, the display source is not available!");
+#else
+      bcm_host_init();
+      source.reset(new BCMDisplayCapture(virtual_width, virtual_height));
+#endif
+    }
+    else {
+      throw invalid_argument("Unknown frame source '" + source_name + "'!");
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+      throw runtime_error("Unable to create socket!");
+    }
+
+    signal(SIGINT, sigintHandler);
+    cout << "Press Ctrl-C to quit..." << endl;
+    uint8_t packet[ArtNet::kMaxPacketSize];
+    vector<PendingFrame> pending(kPendingFrames);
+    for (auto& frame: pending) {
+      frame.frame = 0;
+      frame.shown.resize(nodes.size());
+    }
+    LatencyStats skew("skew");
+    const uint64_t period = 1000000/rate;
+    uint64_t next_frame = LatencyStats::now();
+    uint64_t last_report = next_frame;
+    uint32_t frame = 0;
+    while (running && ((frames == 0) || ((int)frame < frames))) {
+      source->capture();
+      ++frame;
+      const uint8_t sequence = (frame - 1) % 255 + 1;
+      // Send every node its tile, then tell them all when to show it.
+      for (auto& node: nodes) {
+        for (int y=0; y<node.height; ++y) {
+          memcpy(&node.tile[y*node.width*3], source->getRow(node.y + y) + node.x*3,
+                 node.width*3);
+        }
+        const int size = node.tile.size();
+        for (int offset=0, universe=node.first_universe; offset<size;
+             offset+=ArtNet::kUniverseSize, ++universe) {
+          size_t length = ArtNet::buildDmx(packet, universe, sequence,
+                                           &node.tile[offset],
+                                           min(ArtNet::kUniverseSize, size - offset));
+          sendto(sock, packet, length, 0, (struct sockaddr*)&node.address,
+                 sizeof(node.address));
+        }
+      }
+      PendingFrame& slot = pending[frame % kPendingFrames];
+      retire(slot, nodes, skew);
+      ShardProtocol::Packet present;
+      present.type = ShardProtocol::kPresent;
+      present.frame = frame;
+      present.sent_time = LatencyStats::now();
+      present.present_time = present.sent_time + delay_ms*1000;
+      slot.frame = frame;
+      slot.present_time = present.present_time;
+      fill(slot.shown.begin(), slot.shown.end(), 0);
+      slot.acked = 0;
+      for (auto& node: nodes) {
+        present.sent_time = LatencyStats::now();
+        size_t length = ShardProtocol::build(packet, present);
+        sendto(sock, packet, length, 0, (struct sockaddr*)&node.address,
+               sizeof(node.address));
+      }
+
+      // Collect acks until the next frame is due.
+      next_frame += period;
+      uint64_t now = LatencyStats::now();
+      while (running && (now < next_frame)) {
+        struct pollfd poll_fd = { sock, POLLIN, 0 };
+        poll(&poll_fd, 1, max(1, (int)((next_frame - now) / 1000)));
+        receiveAcks(sock, nodes, pending);
+        now = LatencyStats::now();
+      }
+      if (now - last_report > 10000000) {
+        printStats(nodes, skew, frame);
+        last_report = now;
+      }
+    }
+
+    // Wait for the acks of the last frames before the final report.
+    for (uint64_t end = LatencyStats::now() + delay_ms*1000 + 200000;
+         LatencyStats::now() < end; ) {
+      struct pollfd poll_fd = { sock, POLLIN, 0 };
+      poll(&poll_fd, 1, 10);
+      receiveAcks(sock, nodes, pending);
+    }
+    for (auto& slot: pending) {
+      retire(slot, nodes, skew);
+    }
+    printStats(nodes, skew, frame);
+    close(sock);
+  }
+  catch (const exception& ex) {
+    cerr << ex.what() << endl;
+    usage(argv[0]);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,308 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+// Program to propose the fastest way to wire a grid of panels into chains.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <led-matrix.h>
+#include <unistd.h>
+
+#include "Config.h"
+#include "GridTransformer.h"
+
+using namespace std;
+
+// One way of wiring the grid.  A single path visits every panel, running
+// along the rows or the columns from one of the four corners, either
+// snaking back and forth or zigzagging back to the same side at the end of
+// each line.  The path is cut into equal runs, one per parallel output.
+struct Wiring {
+  bool columns,
+       snake,
+       bottom,
+       right;
+  int outputs,
+      chain_length,
+      cable,
+      map_runs;
+  double refresh_hz;
+  vector<GridTransformer::Panel> panels;
+  // Direction the data flows through each panel, one of < > ^ v.
+  string flow;
+
+  string name() const {
+    stringstream s;
+    s << (columns ? "columns" : "rows") << ", " << (snake ? "snake" : "zigzag")
+      << " from " << (bottom ? "bottom" : "top") << " " << (right ? "right" : "left")
+      << ", " << outputs << " output" << ((outputs > 1) ? "s" : "");
+    return s.str();
+  }
+};
+
+static void usage(const char* progname) {
+  std::cerr << "Usage: " << progname << " [flags] [config-file]" << std::endl;
+  std::cerr << "Plans the panels block for the display and panel size in the config file." << std::endl;
+  std::cerr << "Flags:" << std::endl;
+  std::cerr << "\t-g <cols>x<rows> : Grid of panels to plan instead of the config's display size." << std::endl;
+  std::cerr << "\t-o <outputs>     : Parallel outputs available, 1 to 3 (Default: 1)." << std::endl;
+  std::cerr << "\t-k <ns>          : Time to clock one pixel column into the chains (Default: 40)." << std::endl;
+  std::cerr << "\t-a               : List every wiring, not just the best few." << std::endl;
+  rgb_matrix::PrintMatrixFlags(stderr);
+}
+
+// Lay out the path for a wiring and cut it into chains, filling in the
+// order, rotation and parallel output of every panel.  Rotations follow the
+// panels in matrix.cfg: data runs right to left through a panel that is not
+// rotated, left to right at 180 degrees, down at 90 and up at 270.
+static void layout(Wiring* wiring, int rows, int cols) {
+  const int length = wiring->columns ? rows : cols;
+  const int count = rows*cols;
+  wiring->chain_length = (count + wiring->outputs - 1) / wiring->outputs;
+  wiring->panels.assign(count, GridTransformer::Panel());
+  wiring->flow.assign(count, ' ');
+  wiring->cable = 0;
+  int previous_row = -1;
+  int previous_col = -1;
+  for (int step=0; step<count; ++step) {
+    int line = step / length;
+    int position = step % length;
+    // Lines are taken from the starting side, and each line runs away from
+    // the starting side unless it snakes back.
+    bool forward = !wiring->snake || (line % 2 == 0);
+    int row, col;
+    char flow;
+    if (wiring->columns) {
+      col = wiring->right ? cols-1-line : line;
+      bool down = (forward != wiring->bottom);
+      row = down ? position : rows-1-position;
+      flow = down ? 'v' : '^';
+    }
+    else {
+      row = wiring->bottom ? rows-1-line : line;
+      bool leftward = (forward == wiring->right);
+      col = leftward ? cols-1-position : position;
+      flow = leftward ? '<' : '>';
+    }
+    GridTransformer::Panel& panel = wiring->panels[row*cols + col];
+    panel.parallel = step / wiring->chain_length;
+    panel.order = step % wiring->chain_length;
+    panel.rotate = (flow == '<') ? 0 : (flow == '>') ? 180 : (flow == 'v') ? 90 : 270;
+    wiring->flow[row*cols + col] = flow;
+    // Count the cable between panels of a chain in panel pitches.
+    if (panel.order > 0) {
+      wiring->cable += abs(row - previous_row) + abs(col - previous_col);
+    }
+    previous_row = row;
+    previous_col = col;
+  }
+}
+
+// Estimate the refresh rate of the matrices.  Every scan row of every bit
+// plane clocks a pixel column per panel in the chain into all the parallel
+// chains at once, while the previous plane is shown for its weighted time,
+// so a plane takes the longer of the two.
+static double refreshRate(int chain_length, int panel_width, int panel_height,
+                          int pwm_bits, int lsb_ns, double clock_ns) {
+  double shift_ns = chain_length*panel_width*clock_ns;
+  double row_ns = 0;
+  for (int bit=0; bit<pwm_bits; ++bit) {
+    row_ns += max(shift_ns, (double)lsb_ns*(1 << bit));
+  }
+  return 1e9 / (row_ns*(panel_height/2));
+}
+
+// Estimate the CPU cost of mapping a frame through the GridTransformer the
+// way rpi-fb-matrix copies the screen, row by row onto the matrix canvas.
+// Every wiring sets the same pixels, what differs is how scattered the
+// writes are: a display row crossing a panel is one run of neighboring
+// matrix pixels, unless the panel is on its side and the row lands on a
+// matrix column, one run per pixel.  Returns the runs written per frame.
+static int mappingCost(const Wiring& wiring, int rows, int cols,
+                       int panel_width, int panel_height) {
+  int runs = 0;
+  for (int row=0; row<rows; ++row) {
+    for (int col=0; col<cols; ++col) {
+      const int rotate = wiring.panels[row*cols + col].rotate;
+      runs += panel_height*(((rotate == 90) || (rotate == 270)) ? panel_width : 1);
+    }
+  }
+  return runs;
+}
+
+// Print the wiring as a grid of panels, each with its chain (A, B or C),
+// order and the direction the data runs through it.
+static void printDiagram(const Wiring& wiring, int rows, int cols) {
+  for (int row=0; row<rows; ++row) {
+    cout << "   ";
+    for (int col=0; col<cols; ++col) {
+      const GridTransformer::Panel& panel = wiring.panels[row*cols + col];
+      cout << " " << (char)('A' + panel.parallel) << setw(3) << setfill('0')
+           << panel.order << setfill(' ') << wiring.flow[row*cols + col];
+    }
+    cout << endl;
+  }
+}
+
+static void printPanels(const Wiring& wiring, int rows, int cols,
+                        int panel_width, int panel_height) {
+  cout << "display_width = " << cols*panel_width << ";" << endl
+       << "display_height = " << rows*panel_height << ";" << endl
+       << "chain_length = " << wiring.chain_length << ";" << endl
+       << "parallel_count = " << wiring.outputs << ";" << endl
+       << "panels = (" << endl;
+  for (int row=0; row<rows; ++row) {
+    cout << "  (";
+    for (int col=0; col<cols; ++col) {
+      const GridTransformer::Panel& panel = wiring.panels[row*cols + col];
+      cout << " { order = " << setw(3) << panel.order << "; rotate = "
+           << setw(3) << panel.rotate << ";";
+      if (wiring.outputs > 1) {
+        cout << " parallel = " << panel.parallel << ";";
+      }
+      cout << " }" << ((col < cols-1) ? "," : "");
+    }
+    cout << " )" << ((row < rows-1) ? "," : "") << endl;
+  }
+  cout << ")" << endl;
+}
+
+int main(int argc, char** argv) {
+  try {
+    // Initialize from flags, the PWM settings feed the refresh estimate.
+    rgb_matrix::RGBMatrix::Options matrix_options;
+    rgb_matrix::RuntimeOptions runtime_options;
+    if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                           &matrix_options, &runtime_options)) {
+      usage(argv[0]);
+      return 1;
+    }
+    int grid_cols = 0;
+    int grid_rows = 0;
+    int outputs = 1;
+    double clock_ns = 40;
+    bool list_all = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:o:k:a")) != -1) {
+      switch (opt) {
+      case 'g':
+        if (sscanf(optarg, "%dx%d", &grid_cols, &grid_rows) != 2) {
+          throw invalid_argument("Grid must be given as <cols>x<rows>!");
+        }
+        break;
+      case 'o':
+        outputs = atoi(optarg);
+        break;
+      case 'k':
+        clock_ns = atof(optarg);
+        break;
+      case 'a':
+        list_all = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    if ((outputs < 1) || (outputs > 3)) {
+      throw invalid_argument("Parallel outputs must be 1, 2 or 3!");
+    }
+    if (clock_ns <= 0) {
+      throw invalid_argument("Clock time must be positive!");
+    }
+
+    Config config(&matrix_options, optind < argc ? argv[optind] : "/dev/null");
+    const int panel_width = config.getPanelWidth();
+    const int panel_height = config.getPanelHeight();
+    int cols = config.getDisplayWidth() / panel_width;
+    int rows = config.getDisplayHeight() / panel_height;
+    if ((grid_cols != 0) || (grid_rows != 0)) {
+      cols = grid_cols;
+      rows = grid_rows;
+    }
+    if ((cols < 1) || (rows < 1)) {
+      throw invalid_argument("The grid must have at least one panel!");
+    }
+    cout << "Planning " << cols << "x" << rows << " panels of " << panel_width
+         << "x" << panel_height << " pixels on up to " << outputs
+         << " output" << ((outputs > 1) ? "s" : "") << ", pwm_bits "
+         << matrix_options.pwm_bits << endl;
+
+    // Enumerate the wirings.  Columns need panels turned on their side, which
+    // only square panels allow.
+    vector<Wiring> wirings;
+    for (int columns=0; columns<2; ++columns) {
+      if (columns && (panel_width != panel_height)) {
+        continue;
+      }
+      for (int snake=1; snake>=0; --snake) {
+        for (int corner=0; corner<4; ++corner) {
+          for (int used=1; used<=min(outputs, rows*cols); ++used) {
+            Wiring wiring;
+            wiring.columns = columns;
+            wiring.snake = snake;
+            wiring.bottom = corner / 2;
+            wiring.right = corner % 2;
+            wiring.outputs = used;
+            layout(&wiring, rows, cols);
+            // Chains that come out shorter do not save an output.
+            if ((used > 1) && (wiring.chain_length*(used-1) >= rows*cols)) {
+              continue;
+            }
+            wiring.refresh_hz = refreshRate(wiring.chain_length, panel_width,
+                                            panel_height, matrix_options.pwm_bits,
+                                            matrix_options.pwm_lsb_nanoseconds,
+                                            clock_ns);
+            wiring.map_runs = mappingCost(wiring, rows, cols, panel_width,
+                                          panel_height);
+            wirings.push_back(wiring);
+          }
+        }
+      }
+    }
+
+    // Rank by refresh rate, then by mapping cost and then by cable length.
+    // Ties keep the order the wirings were enumerated in, so the same grid
+    // always gives the same plan.
+    stable_sort(wirings.begin(), wirings.end(), [](const Wiring& a, const Wiring& b) {
+      if (a.chain_length != b.chain_length) {
+        return a.chain_length < b.chain_length;
+      }
+      if (a.map_runs != b.map_runs) {
+        return a.map_runs < b.map_runs;
+      }
+      return a.cable < b.cable;
+    });
+
+    cout << endl << "  refresh  map runs    cable  wiring" << endl;
+    const size_t listed = list_all ? wirings.size() : min(wirings.size(), (size_t)8);
+    for (size_t i=0; i<listed; ++i) {
+      const Wiring& wiring = wirings[i];
+      cout << setw(7) << fixed << setprecision(1) << wiring.refresh_hz << "Hz"
+           << setw(10) << wiring.map_runs
+           << setw(9) << wiring.cable << "  " << wiring.name() << endl;
+    }
+    if (listed < wirings.size()) {
+      cout << "  ... " << wirings.size() - listed << " more, use -a to list them" << endl;
+    }
+
+    const Wiring& best = wirings.front();
+    cout << endl << "Best wiring: " << best.name() << endl
+         << "Panels as chain (A, B, C), order and direction of the data from the input:" << endl;
+    printDiagram(best, rows, cols);
+    cout << endl;
+    printPanels(best, rows, cols, panel_width, panel_height);
+  }
+  catch (const exception& ex) {
+    cerr << ex.what() << endl;
+    usage(argv[0]);
+    return -1;
+  }
+  return 0;
+}